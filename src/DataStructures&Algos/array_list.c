@@ -7,9 +7,112 @@
  * 
  */
 
+#define _POSIX_C_SOURCE 200809L
 #include "array_list.h"
+#include "simd_search.h"
+#include "sort.h"
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define ITEM_IS_FLOATING _Generic((Item) 0, float: TRUE, double: TRUE, long double: TRUE, default: FALSE)
+#define ITEM_IS_SIGNED ((Item) -1 < (Item) 0)
+
+#define ITEM_LESS(a, b) ((a) < (b))
+DEFINE_SORT(item, Item, ITEM_LESS)
+
+/* Two sorted runs merged into out by one thread, or with nb 0 a chunk sorted using out as scratch. */
+typedef struct mergeTask {
+    Item *a;
+    size_t na;
+    Item *b;
+    size_t nb;
+    Item *out;
+} MergeTask;
+
+/*
+ * Compares Items of a size the SIMD kernels do not cover.
+ */
+static int same_item(Item a, Item b) {
+    if (ITEM_IS_FLOATING && ARRAY_LIST_EPSILON > 0) return fabsl((long double) a - (long double) b) < ARRAY_LIST_EPSILON;
+    return a == b;
+}
+
+static void new_header(ArrayListHeader *header) {
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+
+    memset(header, 0, sizeof(ArrayListHeader));
+    memcpy(header->magic, ARRAY_LIST_MAGIC, sizeof(ARRAY_LIST_MAGIC));
+    header->version = ARRAY_LIST_VERSION;
+    header->byte_order = 0x01020304;
+    header->item_size = sizeof(Item);
+    header->items_offset = (sizeof(ArrayListHeader) + page - 1) / page * page;
+}
+
+static int write_header(int fd, const ArrayListHeader *header) {
+    return pwrite(fd, header, sizeof(ArrayListHeader), 0) == (ssize_t) sizeof(ArrayListHeader);
+}
+
+/*
+ * Reads and checks a file's header: it must be an Array List of this
+ * Item, with its items mapped at a page boundary, and long enough to hold
+ * them all.
+ */
+static int read_header(int fd, size_t file_size, ArrayListHeader *header) {
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+
+    if (pread(fd, header, sizeof(ArrayListHeader), 0) != (ssize_t) sizeof(ArrayListHeader)) return FALSE;
+    if (memcmp(header->magic, ARRAY_LIST_MAGIC, sizeof(ARRAY_LIST_MAGIC)) != 0) return FALSE;
+    if (header->version != ARRAY_LIST_VERSION || header->byte_order != 0x01020304) return FALSE;
+    if (header->item_size != sizeof(Item) || header->length > UINT_MAX) return FALSE;
+    if (header->items_offset < sizeof(ArrayListHeader) || header->items_offset % page != 0) return FALSE;
+    if (header->items_offset > file_size || header->length > (file_size - header->items_offset) / sizeof(Item)) return FALSE;
+    return TRUE;
+}
+
+static int record_length(ArrayList *list) {
+    ArrayListHeader header;
+
+    if (pread(list->_file->fd, &header, sizeof(ArrayListHeader), 0) != (ssize_t) sizeof(ArrayListHeader)) return FAILURE;
+    header.length = list->length;
+    return write_header(list->_file->fd, &header);
+}
+
+/*
+ * The size a written list's file can be cut to: never below the items
+ * the header on disk counts, or a crash would leave a header claiming
+ * more items than the file holds, which read_header rejects.
+ */
+static size_t file_bytes(size_t bytes, ArrayList *list) {
+    size_t recorded = (size_t) list->_file->recorded_length * sizeof(Item);
+    return bytes > recorded ? bytes : recorded;
+}
+
+/*
+ * Unmaps a list's file and closes it. A written file is checkpointed,
+ * and only once its length is on disk cut down to the pages its items
+ * fill.
+ */
+static void close_file(ArrayList *list) {
+    ArrayListFile *file = list->_file;
+
+    if (file->mode != ARRAY_LIST_MAP_READ) {
+        array_list_sync(list);
+        size_t bytes = file_bytes((size_t) list->length * sizeof(Item), list);
+        Item *items = buffer_resize_file(list->items, file->fd, file->items_offset, bytes, &list->_mapped);
+        if (items) list->items = items;
+    }
+
+    buffer_free(list->items, list->_mapped);
+    close(file->fd);
+    free(file);
+    list->_file = NULL;
+}
 
 ArrayList *array_list_new(unsigned int size) {
     ArrayList *list;
@@ -19,7 +122,9 @@ ArrayList *array_list_new(unsigned int size) {
     list = malloc(sizeof(ArrayList));
     if (!list) return NULL;
 
-    list->items = malloc(size * sizeof(Item));
+    list->_mapped = 0;
+    list->_file = NULL;
+    list->items = buffer_resize(NULL, 0, (size_t) size * sizeof(Item), &list->_mapped);
     if (!list->items) {
         free(list);
         return NULL;
@@ -27,46 +132,182 @@ ArrayList *array_list_new(unsigned int size) {
 
     list->length = 0;
     list->_allocated = size;
+    list->growth = BUFFER_GROW_DOUBLE;
+    list->growth_chunk = BUFFER_DEFAULT_CHUNK;
 
     return list;
 }
 
 void array_list_free(ArrayList *list) {
-    free(list->items);
+    if (list->_file) close_file(list);
+    else buffer_free(list->items, list->_mapped);
     free(list);
 }
 
-int insert(int index, Item item, ArrayList *list) {
-    if (list->length == list->_allocated) {
-        int successful = resize(2 * list->length, list);
-        if (!successful) return FAILURE;
+ArrayList *array_list_open_mapped(const char *path, int mode) {
+    ArrayListHeader header;
+    struct stat st;
+    int flags;
+
+    switch (mode) {
+        case ARRAY_LIST_MAP_READ: flags = O_RDONLY; break;
+        case ARRAY_LIST_MAP_WRITE: flags = O_RDWR | O_CREAT; break;
+        case ARRAY_LIST_MAP_CREATE: flags = O_RDWR | O_CREAT | O_TRUNC; break;
+        default: return NULL;
     }
 
-    if (index > list->length) return FAILURE;
+    int fd = open(path, flags, 0644);
+    if (fd < 0) return NULL;
 
-    list->length++;
+    ArrayList *list = malloc(sizeof(ArrayList));
+    ArrayListFile *file = malloc(sizeof(ArrayListFile));
+    if (!list || !file || fstat(fd, &st) != 0) goto fail;
 
-    for (int i = index; i < list->length; i++) {
-        list->items[i+1] = list->items[i];
+    if (st.st_size == 0 && mode != ARRAY_LIST_MAP_READ) {
+        new_header(&header);
+        if (!write_header(fd, &header)) goto fail;
     }
+    else if (!read_header(fd, (size_t) st.st_size, &header)) goto fail;
+
+    size_t file_items = ((size_t) st.st_size > header.items_offset ? (size_t) st.st_size - header.items_offset : 0) / sizeof(Item);
+    if (file_items > UINT_MAX) file_items = UINT_MAX;
+
+    file->fd = fd;
+    file->mode = mode;
+    file->items_offset = header.items_offset;
+    file->recorded_length = header.length;
+
+    list->_mapped = 0;
+    list->items = buffer_map_file(fd, header.items_offset, file_items * sizeof(Item), mode != ARRAY_LIST_MAP_READ, &list->_mapped);
+    if (!list->items) goto fail;
+
+    // A written file is extended to the end of the mapping; a private one
+    // ends where it did, and the items after it must not be touched.
+    if (mode != ARRAY_LIST_MAP_READ) {
+        file_items = list->_mapped / sizeof(Item);
+        if (file_items > UINT_MAX) file_items = UINT_MAX;
+    }
+
+    list->length = (unsigned int) header.length;
+    list->_allocated = (unsigned int) file_items;
+    list->growth = BUFFER_GROW_DOUBLE;
+    list->growth_chunk = BUFFER_DEFAULT_CHUNK;
+    list->_file = file;
+
+    return list;
+
+fail:
+    free(list);
+    free(file);
+    close(fd);
+    return NULL;
+}
+
+int array_list_sync(ArrayList *list) {
+    if (!list->_file || list->_file->mode == ARRAY_LIST_MAP_READ) return FAILURE;
+
+    // The items go to disk before the length that covers them, so a crash
+    // between the two leaves the previous checkpoint intact.
+    if (!buffer_sync(list->items, list->_mapped)) return FAILURE;
+    if (!record_length(list) || fdatasync(list->_file->fd) != 0) return FAILURE;
+
+    list->_file->recorded_length = list->length;
+    return SUCCESS;
+}
+
+int array_list_advise(int index, unsigned int count, int advice, ArrayList *list) {
+    if (index < 0 || (unsigned int) index > list->length) return FAILURE;
+
+    return buffer_advise(list->items, list->_mapped, (size_t) index * sizeof(Item), (size_t) count * sizeof(Item), advice);
+}
+
+/*
+ * Makes room for needed items, growing by the list's policy so that a run
+ * of single appends stays amortised O(1).
+ */
+static int ensure_capacity(size_t needed, ArrayList *list) {
+    if (needed <= list->_allocated) return SUCCESS;
+    if (needed > UINT_MAX) return FAILURE;
+
+    size_t new_size = buffer_grow(list->_allocated, needed, list->growth, list->growth_chunk);
+    if (new_size > UINT_MAX) new_size = UINT_MAX;
 
-    list->items[index] = item;
+    return resize((unsigned int) new_size, list);
+}
+
+int insert(int index, Item item, ArrayList *list) {
+    return insert_range(index, &item, 1, list);
+}
+
+int insert_range(int index, const Item *items, unsigned int count, ArrayList *list) {
+    return array_list_splice(index, 0, items, count, list);
+}
+
+/*
+ * Finds whether items points into the list's own storage, which growing it
+ * may move and splicing may shift.
+ */
+static int aliases(const Item *items, ArrayList *list) {
+    uintptr_t at = (uintptr_t) items;
+    uintptr_t start = (uintptr_t) list->items;
+    return items && list->items && at >= start && at < start + (uintptr_t) list->_allocated * sizeof(Item);
+}
+
+int array_list_extend(ArrayList *list, const Item *items, unsigned int count) {
+    size_t offset = aliases(items, list) ? (size_t) (items - list->items) : SIZE_MAX;
+
+    if (!ensure_capacity((size_t) list->length + count, list)) return FAILURE;
+
+    // Growing may have moved the items being copied; they lie before the
+    // end of the list, so the copy never overlaps them.
+    if (offset != SIZE_MAX) items = list->items + offset;
+
+    memcpy(list->items + list->length, items, count * sizeof(Item));
+    list->length += count;
 
     return SUCCESS;
 }
 
 int append(Item item, ArrayList *list) {
-    return insert(list->length, item, list);
+    if (list->length == list->_allocated && !ensure_capacity((size_t) list->length + 1, list)) return FAILURE;
+
+    list->items[list->length++] = item;
+    return SUCCESS;
 }
 
 int remove_index(int index, ArrayList *list) {
-    if (index >= list->length) return FAILURE;
+    return remove_range(index, 1, list);
+}
+
+int remove_range(int index, unsigned int count, ArrayList *list) {
+    return array_list_splice(index, count, NULL, 0, list);
+}
+
+int array_list_splice(int index, unsigned int remove_count, const Item *items, unsigned int count, ArrayList *list) {
+    if (index < 0 || (unsigned int) index > list->length) return FAILURE;
+    if (remove_count > list->length - index) return FAILURE;
+
+    // Items from the list itself would be moved by the growth and the shift
+    // of the tail before they are copied, so they are copied out first.
+    Item *copy = NULL;
+    if (count && aliases(items, list)) {
+        copy = malloc(count * sizeof(Item));
+        if (!copy) return FAILURE;
+        memcpy(copy, items, count * sizeof(Item));
+        items = copy;
+    }
 
-    for (int i = index; i < list->length; i++) {
-        list->items[i] = list->items[i+1];
+    if (!ensure_capacity((size_t) list->length - remove_count + count, list)) {
+        free(copy);
+        return FAILURE;
     }
-    list->length--;
 
+    unsigned int tail = list->length - index - remove_count;
+    memmove(list->items + index + count, list->items + index + remove_count, tail * sizeof(Item));
+    if (count) memcpy(list->items + index, items, count * sizeof(Item));
+    list->length = list->length - remove_count + count;
+
+    free(copy);
     return SUCCESS;
 }
 
@@ -75,7 +316,7 @@ int remove(Item value, ArrayList *list) {
 
     if (index == -1) return FAILURE;
 
-    return remove(index, list);
+    return remove_index(index, list);
 }
 
 Item get(int index, ArrayList *list) {
@@ -87,9 +328,21 @@ void clear(ArrayList *list) {
 }
 
 int find(Item item, ArrayList *list) {
-    double err = 1 / 1048576;
-    for (int i = 0; i < list->length; i++) {
-        if (fabs(list->items[i] - item) < err) return i;
+    if (ITEM_IS_FLOATING && sizeof(Item) == sizeof(double)) {
+        return (int) search_find_f64((const double *) list->items, list->length, (double) item, ARRAY_LIST_EPSILON);
+    }
+    if (ITEM_IS_FLOATING && sizeof(Item) == sizeof(float)) {
+        return (int) search_find_f32((const float *) list->items, list->length, (float) item, ARRAY_LIST_EPSILON);
+    }
+    if (!ITEM_IS_FLOATING && sizeof(Item) == sizeof(int32_t)) {
+        return (int) search_find_i32((const int32_t *) list->items, list->length, (int32_t) item);
+    }
+    if (!ITEM_IS_FLOATING && sizeof(Item) == sizeof(int64_t)) {
+        return (int) search_find_i64((const int64_t *) list->items, list->length, (int64_t) item);
+    }
+
+    for (unsigned int i = 0; i < list->length; i++) {
+        if (same_item(list->items[i], item)) return (int) i;
     }
     return -1;
 }
@@ -99,10 +352,22 @@ int contains(Item item, ArrayList *list) {
 }
 
 int count(Item value, ArrayList *list) {
-    double err = 1 / 1048576;
+    if (ITEM_IS_FLOATING && sizeof(Item) == sizeof(double)) {
+        return (int) search_count_f64((const double *) list->items, list->length, (double) value, ARRAY_LIST_EPSILON);
+    }
+    if (ITEM_IS_FLOATING && sizeof(Item) == sizeof(float)) {
+        return (int) search_count_f32((const float *) list->items, list->length, (float) value, ARRAY_LIST_EPSILON);
+    }
+    if (!ITEM_IS_FLOATING && sizeof(Item) == sizeof(int32_t)) {
+        return (int) search_count_i32((const int32_t *) list->items, list->length, (int32_t) value);
+    }
+    if (!ITEM_IS_FLOATING && sizeof(Item) == sizeof(int64_t)) {
+        return (int) search_count_i64((const int64_t *) list->items, list->length, (int64_t) value);
+    }
+
     int cnt = 0;
-    for (int i = 0; i < list->length; i++) {
-        if (fabs(list->items[i] - value) < err) cnt++;
+    for (unsigned int i = 0; i < list->length; i++) {
+        if (same_item(list->items[i], value)) cnt++;
     }
     return cnt;
 }
@@ -111,10 +376,26 @@ int empty(ArrayList *list) {
     return list->length == 0;
 }
 
-int resize(int new_size, ArrayList *list) {
+int resize(unsigned int new_size, ArrayList *list) {
+    size_t used = (size_t) list->length * sizeof(Item);
+    size_t bytes = (size_t) new_size * sizeof(Item);
+    Item *items;
+
     if (new_size < list->length) return FAILURE;
 
-    int *items = realloc(list->items, sizeof(int) * new_size);
+    if (!list->_file) items = buffer_resize(list->items, used, bytes, &list->_mapped);
+    else if (list->_file->mode != ARRAY_LIST_MAP_READ) items = buffer_resize_file(list->items, list->_file->fd, list->_file->items_offset, file_bytes(bytes, list), &list->_mapped);
+    else {
+        // A private mapping cannot grow past the end of its file, so the
+        // list moves into memory of its own and lets the file go.
+        size_t mapped = 0;
+        items = buffer_resize(NULL, 0, bytes, &mapped);
+        if (items) {
+            memcpy(items, list->items, used);
+            close_file(list);
+            list->_mapped = mapped;
+        }
+    }
 
     if (!items) return FAILURE;
 
@@ -124,6 +405,21 @@ int resize(int new_size, ArrayList *list) {
     return SUCCESS;
 }
 
+int reserve(unsigned int count, ArrayList *list) {
+    if (count <= list->_allocated) return SUCCESS;
+
+    return resize(count, list);
+}
+
+int set_growth(int policy, unsigned int chunk, ArrayList *list) {
+    if (policy != BUFFER_GROW_DOUBLE && policy != BUFFER_GROW_HALF && policy != BUFFER_GROW_CHUNK) return FAILURE;
+
+    list->growth = policy;
+    list->growth_chunk = chunk ? chunk : BUFFER_DEFAULT_CHUNK;
+
+    return SUCCESS;
+}
+
 int compress(ArrayList *list) {
     return resize(list->length, list);
 }
@@ -141,75 +437,174 @@ void reverse(ArrayList *list) {
 }
 
 int insertion_sort(ArrayList *list) {
-    for (int i = 1; i < list->length; i++) {
-        int j = i - 1;
-        while (j >= 0 && get(i, list) < get(j, list)) {
-            list->items[j+1] = get(j, list);
-            j--;
-        }
-        list->items[j+1] = get(i, list);
-    }
+    item_insertion_sort(list->items, list->length);
     return SUCCESS;
 }
 
 int merge_sort(ArrayList *list) {
     if (list->length <= 1) return SUCCESS;
 
-    int mid = (int) (list->length / 2);
+    Item *scratch = malloc(list->length * sizeof(Item));
+    if (!scratch) return FAILURE;
 
-    ArrayList *L = array_list_new(mid);
-    if (!L) return FAILURE;
-    
-    ArrayList *R = array_list_new(list->length - mid);
-    if (!R) return FAILURE;
+    item_merge_sort(list->items, list->length, scratch);
 
-    for (int i = 0; i < L->length; i++) {
-        L->items[i] = list->items[i];
+    free(scratch);
+    return SUCCESS;
+}
+
+/*
+ * Runs work on count tasks, the first on the calling thread. A task whose
+ * thread cannot be started is run on the calling thread instead.
+ */
+static void run_tasks(void *(*work)(void *), MergeTask *tasks, unsigned int count) {
+    pthread_t threads[ARRAY_LIST_MAX_THREADS + 1];
+    int started[ARRAY_LIST_MAX_THREADS + 1];
+
+    for (unsigned int i = 1; i < count; i++) {
+        started[i] = pthread_create(&threads[i], NULL, work, &tasks[i]) == 0;
+        if (!started[i]) work(&tasks[i]);
     }
-    for (int i = 0; i < R->length; i++) {
-        R->items[i] = list->items[i+mid];
+
+    work(&tasks[0]);
+
+    for (unsigned int i = 1; i < count; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
     }
-    
-    if (!merge_sort(L)) return FAILURE;
-    if (!merge_sort(R)) return FAILURE;
+}
 
-    int i = 0, j = 0, k = 0;
+static void *sort_chunk(void *arg) {
+    MergeTask *task = arg;
+    item_merge_sort(task->a, task->na, task->out);
+    return NULL;
+}
 
-    while (i < L->length && j < R->length) {
-        if (get(i, L) <= get(j, R)) {
-            list->items[k] = get(i, L);
-            i++;
-        }
-        else {
-            list->items[k] = get(j, R);
-            j++;
-        }
-        k++;
+static void *merge_piece(void *arg) {
+    MergeTask *task = arg;
+    item_merge(task->a, task->na, task->b, task->nb, task->out);
+    return NULL;
+}
+
+/*
+ * Splits the merge of src[lo, mid) and src[mid, hi) into dst into pieces
+ * of equal output length, one task each.
+ */
+static unsigned int plan_merge(Item *src, Item *dst, size_t lo, size_t mid, size_t hi, unsigned int pieces, MergeTask *tasks) {
+    Item *a = src + lo;
+    Item *b = src + mid;
+    size_t na = mid - lo;
+    size_t nb = hi - mid;
+    size_t k0 = 0;
+    size_t i0 = 0;
+
+    for (unsigned int q = 0; q < pieces; q++) {
+        size_t k1 = (hi - lo) * (q + 1) / pieces;
+        size_t i1 = item_merge_split(a, na, b, nb, k1);
+
+        tasks[q].a = a + i0;
+        tasks[q].na = i1 - i0;
+        tasks[q].b = b + (k0 - i0);
+        tasks[q].nb = (k1 - i1) - (k0 - i0);
+        tasks[q].out = dst + lo + k0;
+
+        k0 = k1;
+        i0 = i1;
     }
 
-    while (i < L->length) {
-        list->items[k] = get(i, L);
-        i++;
-        k++;
+    return pieces;
+}
+
+int parallel_merge_sort(unsigned int threads, ArrayList *list) {
+    size_t n = list->length;
+
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (unsigned int) online : 1;
+    }
+    if (threads > n / ARRAY_LIST_PARALLEL_GRAIN) threads = (unsigned int) (n / ARRAY_LIST_PARALLEL_GRAIN);
+    if (threads > ARRAY_LIST_MAX_THREADS) threads = ARRAY_LIST_MAX_THREADS;
+    if (threads <= 1) return merge_sort(list);
+
+    Item *scratch = malloc(n * sizeof(Item));
+    if (!scratch) return FAILURE;
+
+    MergeTask tasks[ARRAY_LIST_MAX_THREADS + 1];
+    size_t bounds[ARRAY_LIST_MAX_THREADS + 1];
+    unsigned int runs = threads;
+
+    // Each thread sorts a chunk of its own, borrowing the same part of scratch.
+    for (unsigned int t = 0; t <= runs; t++) bounds[t] = n * t / runs;
+    for (unsigned int t = 0; t < runs; t++) {
+        tasks[t].a = list->items + bounds[t];
+        tasks[t].na = bounds[t + 1] - bounds[t];
+        tasks[t].out = scratch + bounds[t];
     }
+    run_tasks(sort_chunk, tasks, runs);
+
+    // Merge pairs of runs until one is left, every thread working in every round.
+    Item *src = list->items;
+    Item *dst = scratch;
+    while (runs > 1) {
+        unsigned int pairs = runs / 2;
+        unsigned int pieces = threads / pairs;
+        unsigned int count = 0;
+
+        for (unsigned int p = 0; p < pairs; p++) {
+            count += plan_merge(src, dst, bounds[2 * p], bounds[2 * p + 1], bounds[2 * p + 2], pieces, tasks + count);
+        }
+        if (runs % 2) {
+            count += plan_merge(src, dst, bounds[runs - 1], bounds[runs], bounds[runs], 1, tasks + count);
+        }
+        run_tasks(merge_piece, tasks, count);
 
-    while (j < R->length) {
-        list->items[k] = get(j, R);
-        j++;
-        k++;
+        for (unsigned int r = 1; r <= pairs; r++) bounds[r] = bounds[2 * r];
+        runs = (runs + 1) / 2;
+        bounds[runs] = n;
+
+        Item *tmp = src;
+        src = dst;
+        dst = tmp;
     }
 
-    array_list_free(L);
-    array_list_free(R);
+    if (src != list->items) {
+        run_tasks(merge_piece, tasks, plan_merge(src, list->items, 0, n, n, threads, tasks));
+    }
 
+    free(scratch);
     return SUCCESS;
 }
 
 int quick_sort(ArrayList *list) {
-    qsort(list->items, list->length, sizeof(Item), cmpfunc);
+    item_pdqsort(list->items, list->length);
     return SUCCESS;
 }
 
+int radix_sort(ArrayList *list) {
+    if (ITEM_IS_FLOATING && sizeof(Item) == sizeof(double)) return sort_f64_radix((double *) list->items, list->length);
+    if (ITEM_IS_FLOATING && sizeof(Item) == sizeof(float)) return sort_f32_radix((float *) list->items, list->length);
+    if (ITEM_IS_FLOATING) return FAILURE;
+
+    if (sizeof(Item) == sizeof(uint32_t)) {
+        return ITEM_IS_SIGNED
+            ? sort_i32_radix((int32_t *) list->items, list->length)
+            : sort_u32_radix((uint32_t *) list->items, list->length);
+    }
+    if (sizeof(Item) == sizeof(uint64_t)) {
+        return ITEM_IS_SIGNED
+            ? sort_i64_radix((int64_t *) list->items, list->length)
+            : sort_u64_radix((uint64_t *) list->items, list->length);
+    }
+
+    return FAILURE;
+}
+
+int sort(ArrayList *list) {
+    if (list->length >= ARRAY_LIST_RADIX_MIN && radix_sort(list)) return SUCCESS;
+    return quick_sort(list);
+}
+
 int cmpfunc(void *a, void *b) {
-   return ( *(Item*)a - *(Item*)b );
+    Item x = *(Item*)a;
+    Item y = *(Item*)b;
+    return (x > y) - (x < y);
 }
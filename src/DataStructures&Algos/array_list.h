@@ -12,6 +12,9 @@
 #ifndef WESTLEY_ARRAY_LIST_H
 #define WESTLEY_ARRAY_LIST_H
 
+#include "buffer.h"
+#include <stdint.h>
+
 #define TRUE 1
 #define FALSE 0
 
@@ -24,6 +27,66 @@
 #define Item double
 #endif
 
+// Floating Items closer than this are treated as equal by find, count and
+// contains. Define it as 0 before the include to compare exactly.
+#ifndef ARRAY_LIST_EPSILON
+#define ARRAY_LIST_EPSILON (1.0 / 1048576)
+#endif
+
+/** The length from which sort uses radix sort, when Item allows it. */
+#define ARRAY_LIST_RADIX_MIN 1024
+
+/** The most threads parallel_merge_sort runs on. */
+#define ARRAY_LIST_MAX_THREADS 256
+
+/** The fewest items worth handing to each thread of parallel_merge_sort. */
+#define ARRAY_LIST_PARALLEL_GRAIN 65536
+
+/** Map an existing file; changes stay private to the process and the file is left as it was. */
+#define ARRAY_LIST_MAP_READ 0
+
+/** Map a file, creating it if needed; changes are written back to it. */
+#define ARRAY_LIST_MAP_WRITE 1
+
+/** Map a new, empty file, truncating any file already at the path. */
+#define ARRAY_LIST_MAP_CREATE 2
+
+#define ARRAY_LIST_MAGIC "WALIST"
+#define ARRAY_LIST_VERSION 1
+
+/**
+ * @brief The header at the start of a mapped Array List's file.
+ *
+ * The items follow at items_offset, a whole number of pages in, exactly
+ * as they lie in memory.
+ */
+typedef struct arrayListHeader {
+    char magic[8];
+    uint32_t version;
+    /** 0x01020304 as written, to reject files from hosts of another byte order */
+    uint32_t byte_order;
+    /** sizeof(Item) on the host that wrote the file */
+    uint32_t item_size;
+    uint32_t reserved;
+    /** The number of items as of the last checkpoint */
+    uint64_t length;
+    /** File offset of the items */
+    uint64_t items_offset;
+} ArrayListHeader;
+
+/**
+ * @brief The file behind a mapped Array List.
+ */
+typedef struct arrayListFile {
+    int fd;
+    /** ARRAY_LIST_MAP_READ, ARRAY_LIST_MAP_WRITE or ARRAY_LIST_MAP_CREATE */
+    int mode;
+    /** File offset of the items */
+    uint64_t items_offset;
+    /** The length the header on disk holds; the file is never cut below the items it counts */
+    uint64_t recorded_length;
+} ArrayListFile;
+
 /**
  * @brief Definition of an @ref Array List.
  */
@@ -35,6 +98,14 @@ typedef struct arrayList
     unsigned int length;
     /** Allocated length of the Array List.*/
     unsigned int _allocated;
+    /** How the Array List grows when full: BUFFER_GROW_DOUBLE, BUFFER_GROW_HALF or BUFFER_GROW_CHUNK */
+    int growth;
+    /** The number of items added per growth under BUFFER_GROW_CHUNK */
+    unsigned int growth_chunk;
+    /** The size of the mapping holding items, 0 when items is malloc'd */
+    size_t _mapped;
+    /** The file items is mapped from, NULL for a list in memory */
+    ArrayListFile *_file;
 } ArrayList;
 
 /**
@@ -52,6 +123,50 @@ ArrayList *array_list_new(unsigned int length);
  */
 void array_list_free(ArrayList *list);
 
+/**
+ * @brief Opens an Array List whose items are a memory mapping of a file.
+ *
+ * Every other Array List function works on it unchanged, while the page
+ * cache holds as much of it as fits in memory, so a list can be larger
+ * than RAM. A written list grows by extending the file and remapping, and
+ * its items are never copied. A list opened with ARRAY_LIST_MAP_READ
+ * moves into memory the first time it is resized, and leaves the file
+ * behind.
+ *
+ * @param path The file to map.
+ * @param mode ARRAY_LIST_MAP_READ, ARRAY_LIST_MAP_WRITE or ARRAY_LIST_MAP_CREATE.
+ *
+ * @returns *ArrayList, NULL if the file could not be opened or is not an Array List of this Item.
+ */
+ArrayList *array_list_open_mapped(const char *path, int mode);
+
+/**
+ * @brief Checkpoints a mapped Array List: its items, then its length, are written to the file and flushed to disk.
+ *
+ * Until a checkpoint records a shorter length, the file is not cut below
+ * the last one, so a crash always leaves a file that opens.
+ * array_list_free checkpoints the list before trimming its file.
+ *
+ * @param list The Array List to checkpoint.
+ *
+ * @returns 1 if the checkpoint was written, 0 if it failed or the list is not written back to a file.
+ */
+int array_list_sync(ArrayList *list);
+
+/**
+ * @brief Tells the kernel how a run of a mapped Array List's items will be read.
+ *
+ * Lists in a huge-page mapping take the advice too.
+ *
+ * @param index The index of the first item the advice is for.
+ * @param count The number of items the advice is for.
+ * @param advice BUFFER_ADVISE_NORMAL, BUFFER_ADVISE_SEQUENTIAL, BUFFER_ADVISE_RANDOM or BUFFER_ADVISE_WILLNEED.
+ * @param list The Array List to advise on.
+ *
+ * @returns 1 if the advice was taken, 0 if the list is malloc'd or the advice is unknown.
+ */
+int array_list_advise(int index, unsigned int count, int advice, ArrayList *list);
+
 /**
  * @brief Add an item to a specified index of the Array List.
  *
@@ -73,6 +188,62 @@ int insert(int index, Item item, ArrayList *list);
  */
 int append(Item item, ArrayList *list);
 
+/**
+ * @brief Add many items to the end of the Array List.
+ *
+ * Room is made once and the items are copied in with a single memcpy.
+ * The items may come from the list itself.
+ *
+ * @param list The Array List to extend.
+ * @param items The items to append.
+ * @param count The number of items.
+ *
+ * @returns 1 if the items were appended, 0 otherwise.
+ */
+int array_list_extend(ArrayList *list, const Item *items, unsigned int count);
+
+/**
+ * @brief Add many items at a specified index of the Array List.
+ *
+ * The items after index are shifted up once, with a single memmove.
+ *
+ * @param index The index where the first item must go.
+ * @param items The items to insert.
+ * @param count The number of items.
+ * @param list The Array List to insert to.
+ *
+ * @returns 1 if the insert was successful, 0 otherwise.
+ */
+int insert_range(int index, const Item *items, unsigned int count, ArrayList *list);
+
+/**
+ * @brief Remove a run of consecutive items from the Array List.
+ *
+ * @param index The index of the first item to be removed.
+ * @param count The number of items to remove.
+ * @param list The Array List to be removed from.
+ *
+ * @returns 1 if the items were removed, 0 if the run does not fit in the list.
+ */
+int remove_range(int index, unsigned int count, ArrayList *list);
+
+/**
+ * @brief Replace a run of items of the Array List with other items.
+ *
+ * The tail of the list moves at most once, whatever the two counts are.
+ * The items may come from the list itself, in which case they are copied
+ * aside first.
+ *
+ * @param index The index of the first item to be replaced.
+ * @param remove_count The number of items to remove.
+ * @param items The items to insert in their place, may be NULL when count is 0.
+ * @param count The number of items to insert.
+ * @param list The Array List to be changed.
+ *
+ * @returns 1 if the splice was successful, 0 otherwise.
+ */
+int array_list_splice(int index, unsigned int remove_count, const Item *items, unsigned int count, ArrayList *list);
+
 /**
  * @brief Remove an item from a specific position of the Array List.
  *
@@ -113,6 +284,9 @@ void clear(ArrayList *list);
 /**
  * @brief Gets the index of an item in an Array List.
  *
+ * Items of 32 and 64 bits are searched with the widest SIMD instructions
+ * the CPU supports.
+ *
  * @param item The item to be searched for.
  * @param list The Array List to be searched.
  *
@@ -152,12 +326,40 @@ int empty(ArrayList *list);
 /**
  * @brief Changes the size of an Array List.
  *
+ * Lists of BUFFER_MMAP_MIN bytes or more are kept in a huge-page mapping
+ * on Linux, so they grow without copying their items. A list mapped from
+ * a file for writing resizes the file with it.
+ *
  * @param new_size The new size of the Array List.
  * @param list The Array List to be altered.
  *
  * @returns 1 if the change was successful, 0 otherwise.
  */
-int resize(int new_size, ArrayList *list);
+int resize(unsigned int new_size, ArrayList *list);
+
+/**
+ * @brief Makes room for a number of items, so the Array List can reach that length without growing.
+ *
+ * @param count The number of items to make room for.
+ * @param list The Array List to be altered.
+ *
+ * @returns 1 if the Array List has room for count items, 0 otherwise.
+ */
+int reserve(unsigned int count, ArrayList *list);
+
+/**
+ * @brief Chooses how an Array List grows once it is full.
+ *
+ * Lists start out doubling. Growing by half wastes less memory on huge
+ * lists, and fixed chunks suit lists that grow slowly by known amounts.
+ *
+ * @param policy BUFFER_GROW_DOUBLE, BUFFER_GROW_HALF or BUFFER_GROW_CHUNK.
+ * @param chunk The number of items added per growth under BUFFER_GROW_CHUNK, 0 for BUFFER_DEFAULT_CHUNK.
+ * @param list The Array List to configure.
+ *
+ * @returns 1 if the policy was set, 0 if it is not a known policy.
+ */
+int set_growth(int policy, unsigned int chunk, ArrayList *list);
 
 /**
  * @brief Reduces the size of an Array List to its length.
@@ -187,21 +389,65 @@ int insertion_sort(ArrayList *list);
 /**
  * @brief Sorts an Array List using merge sort.
  *
+ * The sort is stable and bottom-up. It makes a single allocation, a
+ * scratch buffer the size of the list.
+ *
  * @param list The Array List to be sorted.
  *
  * @returns 1 if the sort was successful, 0 otherwise.
  */
 int merge_sort(ArrayList *list);
 
+/**
+ * @brief Sorts an Array List using merge sort spread across several threads.
+ *
+ * Each thread merge sorts a chunk of the list. The chunks are then merged
+ * pairwise, each merge split by output position so that every thread
+ * takes part in every round. Stable, with one scratch buffer.
+ *
+ * @param threads The number of threads to use, 0 for one per online CPU.
+ * @param list The Array List to be sorted.
+ *
+ * @returns 1 if the sort was successful, 0 otherwise.
+ */
+int parallel_merge_sort(unsigned int threads, ArrayList *list);
+
 /**
  * @brief Sorts an Array List using quick sort.
  *
+ * Runs a pattern-defeating quicksort specialised for Item, so comparisons
+ * are inlined rather than called through a pointer. Worst case O(n log n).
+ *
  * @param list The Array List to be sorted.
  *
  * @returns 1 if the sort was successful, 0 otherwise.
  */
 int quick_sort(ArrayList *list);
 
+/**
+ * @brief Sorts an Array List using LSD radix sort.
+ *
+ * Only 32 and 64-bit integer and floating Items can be radix sorted.
+ * Needs a scratch copy of the items.
+ *
+ * @param list The Array List to be sorted.
+ *
+ * @returns 1 if the sort was successful, 0 if Item cannot be radix sorted or memory ran out.
+ */
+int radix_sort(ArrayList *list);
+
+/**
+ * @brief Sorts an Array List with whichever algorithm suits its length and Item.
+ *
+ * Lists of at least ARRAY_LIST_RADIX_MIN items are radix sorted when
+ * possible, everything else is quick sorted.
+ *
+ * @param list The Array List to be sorted.
+ *
+ * @returns 1 if the sort was successful, 0 otherwise.
+ */
+int sort(ArrayList *list);
+
 /**
  * @brief Comparison function for qsort
 */
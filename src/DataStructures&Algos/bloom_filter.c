@@ -0,0 +1,134 @@
+/**
+ * @file bloom_filter.c
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief A blocked Bloom filter over 64-bit hashes.
+ *
+ */
+
+#include "bloom_filter.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define BLOCK_WORDS (BLOOM_BLOCK_BITS / 64)
+#define BLOCK_BYTES (BLOOM_BLOCK_BITS / 8)
+
+/* Shifting a 64-bit word right by this leaves log2(BLOOM_BLOCK_BITS) bits. */
+#define BIT_SHIFT (64 - 9)
+
+#define BLOOM_SALT 0x9e3779b97f4a7c15ULL
+#define BLOOM_STEP 0xd6e8feb86659fd93ULL
+
+/* ln 2, spelled out as M_LN2 is not ISO C. */
+#define LN_2 0.6931471805599453
+
+/*
+ * Picks the block a hash sets its bits in, after remixing the hash so the
+ * choice is independent of a map's buckets.
+ */
+static uint64_t *block_of(uint64_t *x, BloomFilter *filter) {
+    *x = hash_u64(*x, BLOOM_SALT);
+    return filter->bits + (((*x >> 32) * filter->block_count) >> 32) * BLOCK_WORDS;
+}
+
+/*
+ * Steps to the next bit of a key inside its block. Each step multiplies
+ * the state by an odd constant and takes the top bits of the product,
+ * so every probe draws fresh, nearly independent bits.
+ */
+static unsigned int next_bit(uint64_t *x) {
+    *x *= BLOOM_STEP;
+    return (unsigned int) (*x >> BIT_SHIFT);
+}
+
+static unsigned int probes_for(double bits_per_key) {
+    // k = ln 2 * bits per key minimises the false-positive rate.
+    long probes = lround(bits_per_key * LN_2);
+    return probes < 1 ? 1 : probes > BLOOM_MAX_PROBES ? BLOOM_MAX_PROBES : (unsigned int) probes;
+}
+
+/*
+ * The expected false-positive rate of a blocked filter. The number of keys
+ * landing in a block is Poisson distributed, and crowded blocks answer
+ * falsely far more often than the average would suggest.
+ */
+static double blocked_rate(double bits_per_key) {
+    unsigned int k = probes_for(bits_per_key);
+    double mean = BLOOM_BLOCK_BITS / bits_per_key;
+    double weight = exp(-mean);
+    double rate = 0;
+
+    for (unsigned int keys = 0; keys < 8 * mean + 64; keys++) {
+        double bit_set = 1 - pow(1 - 1.0 / BLOOM_BLOCK_BITS, (double) k * keys);
+        rate += weight * pow(bit_set, k);
+        weight *= mean / (keys + 1);
+    }
+
+    return rate;
+}
+
+double bloom_bits_per_key(double fp_rate) {
+    if (fp_rate >= 1) return 1;
+
+    double bits = 1;
+    while (bits < 64 && blocked_rate(bits) > fp_rate) bits += 0.25;
+    return bits;
+}
+
+BloomFilter *bloom_filter_new(unsigned int capacity, double bits_per_key) {
+    if (!(bits_per_key >= 1)) bits_per_key = 1;
+
+    BloomFilter *filter = malloc(sizeof(BloomFilter));
+    if (!filter) return NULL;
+
+    double blocks = ceil(capacity * bits_per_key / BLOOM_BLOCK_BITS);
+    filter->block_count = blocks < 1 ? 1 : blocks > UINT32_MAX / 2 ? UINT32_MAX / 2 : (unsigned int) blocks;
+    filter->capacity = capacity;
+
+    filter->probes = probes_for(bits_per_key);
+
+    filter->bits = aligned_alloc(BLOCK_BYTES, (size_t) filter->block_count * BLOCK_BYTES);
+    if (!filter->bits) {
+        free(filter);
+        return NULL;
+    }
+
+    bloom_filter_clear(filter);
+
+    return filter;
+}
+
+void bloom_filter_free(BloomFilter *filter) {
+    free(filter->bits);
+    free(filter);
+}
+
+void bloom_add(uint64_t hash, BloomFilter *filter) {
+    uint64_t x = hash;
+    uint64_t *block = block_of(&x, filter);
+
+    for (unsigned int i = 0; i < filter->probes; i++) {
+        unsigned int bit = next_bit(&x);
+        block[bit >> 6] |= 1ULL << (bit & 63);
+    }
+}
+
+int bloom_may_contain(uint64_t hash, BloomFilter *filter) {
+    uint64_t x = hash;
+    uint64_t *block = block_of(&x, filter);
+
+    // All probes are tested without branching; they share one cache line anyway.
+    uint64_t missing = 0;
+    for (unsigned int i = 0; i < filter->probes; i++) {
+        unsigned int bit = next_bit(&x);
+        missing |= ~block[bit >> 6] & (1ULL << (bit & 63));
+    }
+
+    return missing ? FALSE : TRUE;
+}
+
+void bloom_filter_clear(BloomFilter *filter) {
+    memset(filter->bits, '\0', (size_t) filter->block_count * BLOCK_BYTES);
+}
@@ -0,0 +1,110 @@
+/**
+ * @file bloom_filter.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief A blocked Bloom filter over 64-bit hashes.
+ *
+ * A Bloom filter answers "definitely absent" or "possibly present" for a
+ * key, using a few bits per key. This one is blocked: each hash selects a
+ * single 64-byte block and sets all of its bits inside it, so a query
+ * touches one cache line however many bits it tests.
+ *
+ * The filter works on hashes rather than keys, so it can sit in front of
+ * any map and reuse the hash that map already computes. It cannot forget a
+ * key; a map that removes keys has to rebuild it now and then.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_BLOOM_FILTER_H
+#define WESTLEY_BLOOM_FILTER_H
+
+#define TRUE 1
+#define FALSE 0
+
+#define SUCCESS 1
+#define FAILURE 0
+
+#include "hash.h"
+
+/** The number of bits in a block, one cache line. */
+#define BLOOM_BLOCK_BITS 512
+
+/** The most bits set per key. */
+#define BLOOM_MAX_PROBES 16
+
+/**
+ * @brief Definition of a @ref Bloom Filter.
+ */
+typedef struct bloomFilter {
+    /** The number of 512-bit blocks */
+    unsigned int block_count;
+    /** The number of bits set per key */
+    unsigned int probes;
+    /** The number of keys the filter was sized for */
+    unsigned int capacity;
+    /** The blocks, aligned to a cache line */
+    uint64_t *bits;
+} BloomFilter;
+
+/**
+ * @brief Gets the bits per key needed for a false-positive rate.
+ *
+ * Blocking costs some accuracy, which is accounted for: a 1% rate takes
+ * about 10 bits per key, and 0.1% about 16.
+ *
+ * @param fp_rate The wanted false-positive rate, between 0 and 1.
+ *
+ * @returns The number of bits per key to pass to bloom_filter_new, at most 64.
+ */
+double bloom_bits_per_key(double fp_rate);
+
+/**
+ * @brief Allocates a new, empty Bloom Filter for use.
+ *
+ * About 10 bits per key give a 1% false-positive rate. Each further
+ * halving of the rate costs more bits than the last, because keys crowd
+ * some blocks more than others.
+ *
+ * @param capacity The number of keys to size the filter for.
+ * @param bits_per_key The number of bits to spend per key, from 1 upwards.
+ *
+ * @returns *BloomFilter
+ */
+BloomFilter *bloom_filter_new(unsigned int capacity, double bits_per_key);
+
+/**
+ * @brief Destroys a Bloom Filter and frees the memory back.
+ *
+ * @param filter The Bloom Filter to free.
+ */
+void bloom_filter_free(BloomFilter *filter);
+
+/**
+ * @brief Adds a key's hash to a Bloom Filter.
+ *
+ * @param hash The 64-bit hash of the key.
+ * @param filter The Bloom Filter to add to.
+ */
+void bloom_add(uint64_t hash, BloomFilter *filter);
+
+/**
+ * @brief Checks a Bloom Filter for a key's hash.
+ *
+ * @param hash The 64-bit hash of the key.
+ * @param filter The Bloom Filter to check.
+ *
+ * @returns 0 if the key was never added, 1 if it may have been.
+ */
+int bloom_may_contain(uint64_t hash, BloomFilter *filter);
+
+/**
+ * @brief Removes every key from a Bloom Filter.
+ *
+ * @param filter The Bloom Filter to clear.
+ */
+void bloom_filter_clear(BloomFilter *filter);
+
+#endif
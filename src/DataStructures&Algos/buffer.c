@@ -0,0 +1,201 @@
+/**
+ * @file buffer.c
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief Growable storage for the dynamic arrays.
+ *
+ */
+
+#define _GNU_SOURCE
+#include "buffer.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BUFFER_CAN_MAP
+#endif
+
+size_t buffer_grow(size_t capacity, size_t needed, int policy, size_t chunk) {
+    size_t next;
+
+    switch (policy) {
+        case BUFFER_GROW_HALF: next = capacity + capacity / 2; break;
+        case BUFFER_GROW_CHUNK: next = capacity + (chunk ? chunk : BUFFER_DEFAULT_CHUNK); break;
+        default: next = 2 * capacity;
+    }
+
+    return next < needed ? needed : next;
+}
+
+#ifdef BUFFER_CAN_MAP
+
+static size_t round_to_huge_page(size_t bytes) {
+    return (bytes + BUFFER_HUGE_PAGE - 1) & ~(BUFFER_HUGE_PAGE - 1);
+}
+
+static void advise_huge(void *data, size_t bytes) {
+#ifdef MADV_HUGEPAGE
+    madvise(data, bytes, MADV_HUGEPAGE);
+#endif
+}
+
+/*
+ * Maps bytes (a multiple of BUFFER_HUGE_PAGE) at a huge-page boundary.
+ * One huge page more is mapped and the misaligned ends are unmapped, as
+ * the kernel only backs aligned ranges with huge pages.
+ */
+static void *map_huge(size_t bytes) {
+    char *raw = mmap(NULL, bytes + BUFFER_HUGE_PAGE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+
+    char *data = (char *) (((size_t) raw + BUFFER_HUGE_PAGE - 1) & ~(BUFFER_HUGE_PAGE - 1));
+    if (data > raw) munmap(raw, data - raw);
+    munmap(data + bytes, raw + BUFFER_HUGE_PAGE - data);
+
+    advise_huge(data, bytes);
+    return data;
+}
+
+#endif
+
+void *buffer_resize(void *data, size_t used, size_t bytes, size_t *mapped) {
+    if (used > bytes) used = bytes;
+
+#ifdef BUFFER_CAN_MAP
+    if (bytes >= BUFFER_MMAP_MIN) {
+        size_t map_bytes = round_to_huge_page(bytes);
+
+        if (*mapped) {
+            if (map_bytes == *mapped) return data;
+
+            void *moved = mremap(data, *mapped, map_bytes, MREMAP_MAYMOVE);
+            if (moved == MAP_FAILED) return NULL;
+
+            advise_huge(moved, map_bytes);
+            *mapped = map_bytes;
+            return moved;
+        }
+
+        void *fresh = map_huge(map_bytes);
+        if (fresh) {
+            if (used) memcpy(fresh, data, used);
+            free(data);
+            *mapped = map_bytes;
+            return fresh;
+        }
+        // Without a mapping the buffer can still live in malloc memory.
+    }
+    else if (*mapped) {
+        void *fresh = malloc(bytes ? bytes : 1);
+        if (!fresh) return NULL;
+
+        if (used) memcpy(fresh, data, used);
+        munmap(data, *mapped);
+        *mapped = 0;
+        return fresh;
+    }
+#endif
+
+    return realloc(data, bytes ? bytes : 1);
+}
+
+void buffer_free(void *data, size_t mapped) {
+#ifdef BUFFER_CAN_MAP
+    if (mapped) {
+        munmap(data, mapped);
+        return;
+    }
+#endif
+    free(data);
+}
+
+#ifdef BUFFER_CAN_MAP
+
+static size_t round_to_page(size_t bytes) {
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    return bytes ? (bytes + page - 1) / page * page : page;
+}
+
+static int set_file_size(int fd, size_t bytes) {
+    return ftruncate(fd, (off_t) bytes) == 0;
+}
+
+void *buffer_map_file(int fd, size_t offset, size_t bytes, int shared, size_t *mapped) {
+    size_t map_bytes = round_to_page(bytes);
+
+    if (shared) {
+        struct stat st;
+        if (fstat(fd, &st) != 0) return NULL;
+        if ((size_t) st.st_size < offset + map_bytes && !set_file_size(fd, offset + map_bytes)) return NULL;
+    }
+
+    void *data = mmap(NULL, map_bytes, PROT_READ | PROT_WRITE, shared ? MAP_SHARED : MAP_PRIVATE, fd, (off_t) offset);
+    if (data == MAP_FAILED) return NULL;
+
+    *mapped = map_bytes;
+    return data;
+}
+
+void *buffer_resize_file(void *data, int fd, size_t offset, size_t bytes, size_t *mapped) {
+    size_t map_bytes = round_to_page(bytes);
+    if (map_bytes == *mapped) return data;
+
+    // Touching a page past the end of the file faults, so the file is
+    // extended before the mapping grows, and cut back after it shrinks.
+    if (map_bytes > *mapped && !set_file_size(fd, offset + map_bytes)) return NULL;
+
+    void *moved = mremap(data, *mapped, map_bytes, MREMAP_MAYMOVE);
+    if (moved == MAP_FAILED) {
+        if (map_bytes > *mapped) set_file_size(fd, offset + *mapped);
+        return NULL;
+    }
+
+    // A file that cannot be cut back only keeps some wasted space.
+    if (map_bytes < *mapped) set_file_size(fd, offset + map_bytes);
+
+    *mapped = map_bytes;
+    return moved;
+}
+
+int buffer_advise(void *data, size_t mapped, size_t from, size_t bytes, int advice) {
+    static const int advices[] = { MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM, MADV_WILLNEED };
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+
+    if (!mapped || advice < BUFFER_ADVISE_NORMAL || advice > BUFFER_ADVISE_WILLNEED) return 0;
+    if (from >= mapped) return 1;
+    if (bytes > mapped - from) bytes = mapped - from;
+
+    size_t start = from / page * page;
+    size_t end = round_to_page(from + bytes);
+    if (end > mapped) end = mapped;
+
+    return madvise((char *) data + start, end - start, advices[advice]) == 0;
+}
+
+int buffer_sync(void *data, size_t mapped) {
+    return msync(data, mapped, MS_SYNC) == 0;
+}
+
+#else
+
+void *buffer_map_file(int fd, size_t offset, size_t bytes, int shared, size_t *mapped) {
+    return NULL;
+}
+
+void *buffer_resize_file(void *data, int fd, size_t offset, size_t bytes, size_t *mapped) {
+    return NULL;
+}
+
+int buffer_advise(void *data, size_t mapped, size_t from, size_t bytes, int advice) {
+    return 0;
+}
+
+int buffer_sync(void *data, size_t mapped) {
+    return 0;
+}
+
+#endif
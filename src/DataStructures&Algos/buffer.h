@@ -0,0 +1,144 @@
+/**
+ * @file buffer.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief Growable storage for the dynamic arrays.
+ *
+ * Small buffers live in malloc memory. On Linux, a buffer that reaches
+ * BUFFER_MMAP_MIN bytes moves to an anonymous mapping advised to use
+ * transparent huge pages. From then on it grows with mremap, which moves
+ * page table entries rather than copying data, and large lists pay for
+ * far fewer TLB misses.
+ *
+ * A buffer can also be a shared mapping of a file, grown by extending the
+ * file and remapping, so its contents persist without being copied.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_BUFFER_H
+#define WESTLEY_BUFFER_H
+
+#include <stddef.h>
+
+/** Grow by doubling the capacity. */
+#define BUFFER_GROW_DOUBLE 0
+
+/** Grow by half the capacity, wasting less memory on huge buffers. */
+#define BUFFER_GROW_HALF 1
+
+/** Grow by a fixed number of items. */
+#define BUFFER_GROW_CHUNK 2
+
+/** The number of items added per growth under BUFFER_GROW_CHUNK when none is given. */
+#define BUFFER_DEFAULT_CHUNK 1024
+
+// Define BUFFER_MMAP_MIN before the include to change the size from which
+// buffers are mapped rather than malloc'd.
+#ifndef BUFFER_MMAP_MIN
+#define BUFFER_MMAP_MIN ((size_t) 32 << 20)
+#endif
+
+/** The size of a transparent huge page; mappings are whole multiples of it. */
+#define BUFFER_HUGE_PAGE ((size_t) 2 << 20)
+
+/** No special treatment of a mapped buffer's pages. */
+#define BUFFER_ADVISE_NORMAL 0
+
+/** The buffer will be read in order: read ahead aggressively and drop pages once read. */
+#define BUFFER_ADVISE_SEQUENTIAL 1
+
+/** The buffer will be read at random: do not read ahead. */
+#define BUFFER_ADVISE_RANDOM 2
+
+/** The pages will be needed soon: start reading them in now. */
+#define BUFFER_ADVISE_WILLNEED 3
+
+/**
+ * @brief Works out the capacity a full buffer grows to.
+ *
+ * @param capacity The current capacity, in items.
+ * @param needed The fewest items the buffer must hold.
+ * @param policy BUFFER_GROW_DOUBLE, BUFFER_GROW_HALF or BUFFER_GROW_CHUNK.
+ * @param chunk The number of items added under BUFFER_GROW_CHUNK.
+ *
+ * @returns The new capacity, at least needed.
+ */
+size_t buffer_grow(size_t capacity, size_t needed, int policy, size_t chunk);
+
+/**
+ * @brief Resizes a buffer, moving it between malloc and a huge-page mapping as its size demands.
+ *
+ * @param data The buffer, may be NULL.
+ * @param used The number of leading bytes that must be kept.
+ * @param bytes The new size.
+ * @param mapped The size of the buffer's mapping, 0 when it is malloc'd; updated.
+ *
+ * @returns The resized buffer, NULL if it could not be resized, in which case data is untouched.
+ */
+void *buffer_resize(void *data, size_t used, size_t bytes, size_t *mapped);
+
+/**
+ * @brief Frees a buffer.
+ *
+ * @param data The buffer, may be NULL.
+ * @param mapped The size of the buffer's mapping, 0 when it is malloc'd.
+ */
+void buffer_free(void *data, size_t mapped);
+
+/**
+ * @brief Maps part of a file as a buffer.
+ *
+ * A shared mapping writes changes back to the file, which is extended to
+ * cover the whole mapping; a private one keeps them to the process and
+ * leaves the file as it is.
+ *
+ * @param fd The file, open for reading, and for writing too when shared.
+ * @param offset The file offset the buffer starts at, a multiple of the page size.
+ * @param bytes The size of the buffer.
+ * @param shared Whether changes are written back to the file.
+ * @param mapped Receives the size of the mapping, bytes rounded up to whole pages.
+ *
+ * @returns The buffer, NULL if the file could not be mapped.
+ */
+void *buffer_map_file(int fd, size_t offset, size_t bytes, int shared, size_t *mapped);
+
+/**
+ * @brief Resizes a shared file mapping, growing or shrinking the file with it.
+ *
+ * @param data The buffer, from buffer_map_file.
+ * @param fd The file the buffer maps.
+ * @param offset The file offset the buffer starts at.
+ * @param bytes The new size.
+ * @param mapped The size of the mapping; updated.
+ *
+ * @returns The resized buffer, NULL if it could not be resized, in which case data is untouched.
+ */
+void *buffer_resize_file(void *data, int fd, size_t offset, size_t bytes, size_t *mapped);
+
+/**
+ * @brief Tells the kernel how a mapped buffer's pages will be used.
+ *
+ * @param data The buffer.
+ * @param mapped The size of the buffer's mapping, 0 when it is malloc'd.
+ * @param from The offset of the first byte the advice is for.
+ * @param bytes The number of bytes the advice is for; the range is widened to whole pages.
+ * @param advice BUFFER_ADVISE_NORMAL, BUFFER_ADVISE_SEQUENTIAL, BUFFER_ADVISE_RANDOM or BUFFER_ADVISE_WILLNEED.
+ *
+ * @returns 1 if the advice was taken, 0 if the buffer is not mapped or the advice is unknown.
+ */
+int buffer_advise(void *data, size_t mapped, size_t from, size_t bytes, int advice);
+
+/**
+ * @brief Writes a shared file mapping's changes back to the file and waits for them.
+ *
+ * @param data The buffer, from buffer_map_file.
+ * @param mapped The size of the mapping.
+ *
+ * @returns 1 if the changes were written, 0 otherwise.
+ */
+int buffer_sync(void *data, size_t mapped);
+
+#endif
@@ -0,0 +1,294 @@
+/**
+ * @file cache.c
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief A bounded key-value cache with LRU or CLOCK eviction.
+ *
+ */
+
+#include "cache.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+static unsigned int bucket_of(uint64_t hash, unsigned int size) {
+    return (unsigned int) (((hash >> 32) * size) >> 32);
+}
+
+static CacheEntry *alloc_entry(Cache *cache) {
+    if (cache->free_entries) {
+        CacheEntry *entry = cache->free_entries;
+        cache->free_entries = entry->chain;
+        return entry;
+    }
+
+    if (cache->slab_left == 0) {
+        CacheSlab *slab = malloc(sizeof(CacheSlab));
+        if (!slab) return NULL;
+
+        slab->next = cache->slabs;
+        cache->slabs = slab;
+        cache->slab_left = CACHE_SLAB_ENTRIES;
+    }
+
+    return &cache->slabs->entries[CACHE_SLAB_ENTRIES - cache->slab_left--];
+}
+
+static void free_entry(CacheEntry *entry, Cache *cache) {
+    entry->chain = cache->free_entries;
+    cache->free_entries = entry;
+}
+
+static void free_slabs(Cache *cache) {
+    CacheSlab *current = cache->slabs;
+    CacheSlab *prev;
+    while (current)
+    {
+        prev = current;
+        current = current->next;
+        free(prev);
+    }
+    cache->slabs = NULL;
+    cache->slab_left = 0;
+    cache->free_entries = NULL;
+}
+
+/*
+ * Links an entry into the circular list just before the head. Under LRU
+ * it then becomes the head; under CLOCK it is the last entry the hand
+ * reaches, which gives it a full sweep before it can be evicted.
+ */
+static void ring_insert(CacheEntry *entry, Cache *cache) {
+    if (!cache->head) {
+        entry->prev = entry;
+        entry->next = entry;
+        cache->head = entry;
+        return;
+    }
+
+    entry->next = cache->head;
+    entry->prev = cache->head->prev;
+    entry->prev->next = entry;
+    cache->head->prev = entry;
+
+    if (cache->policy == CACHE_LRU) cache->head = entry;
+}
+
+static void ring_unlink(CacheEntry *entry, Cache *cache) {
+    if (entry->next == entry) {
+        cache->head = NULL;
+        return;
+    }
+
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    if (cache->head == entry) cache->head = entry->next;
+}
+
+static CacheEntry **find_link(Key key, uint64_t hash, Cache *cache) {
+    CacheEntry **link = &cache->buckets[bucket_of(hash, cache->size)];
+    while (*link) {
+        if ((*link)->hash == hash && cache->cmp(key, (*link)->key) == 0) return link;
+        link = &(*link)->chain;
+    }
+    return NULL;
+}
+
+/*
+ * Doubles the buckets once there are more entries than buckets. Failing to
+ * grow is not an error: the Cache keeps working, only with longer chains.
+ */
+static void grow(Cache *cache) {
+    if (cache->item_count <= cache->size || cache->size >= UINT_MAX / 2) return;
+
+    unsigned int size = cache->size * 2;
+    CacheEntry **buckets = calloc(size, sizeof(CacheEntry*));
+    if (!buckets) return;
+
+    for (unsigned int i = 0; i < cache->size; i++) {
+        CacheEntry *entry = cache->buckets[i];
+        while (entry) {
+            CacheEntry *next = entry->chain;
+            unsigned int b = bucket_of(entry->hash, size);
+            entry->chain = buckets[b];
+            buckets[b] = entry;
+            entry = next;
+        }
+    }
+
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->size = size;
+}
+
+/*
+ * Picks the next victim. The CLOCK hand clears reference bits as it
+ * passes, so it stops within one full sweep.
+ */
+static CacheEntry *victim(Cache *cache) {
+    if (cache->policy == CACHE_LRU) return cache->head->prev;
+
+    while (cache->head->referenced) {
+        cache->head->referenced = FALSE;
+        cache->head = cache->head->next;
+    }
+    return cache->head;
+}
+
+static void drop(CacheEntry *entry, Cache *cache) {
+    ring_unlink(entry, cache);
+    *find_link(entry->key, entry->hash, cache) = entry->chain;
+    cache->used -= entry->cost;
+    cache->item_count--;
+    free_entry(entry, cache);
+}
+
+Cache *cache_new(unsigned int capacity, int policy, HashFunc hashfunc, CmpFunc cmp) {
+    if (capacity == 0 || (policy != CACHE_LRU && policy != CACHE_CLOCK)) return NULL;
+
+    Cache *cache = malloc(sizeof(Cache));
+    if (!cache) return NULL;
+
+    cache->buckets = calloc(CACHE_MIN_BUCKETS, sizeof(CacheEntry*));
+    if (!cache->buckets) {
+        free(cache);
+        return NULL;
+    }
+
+    cache->capacity = capacity;
+    cache->used = 0;
+    cache->item_count = 0;
+    cache->policy = policy;
+    cache->size = CACHE_MIN_BUCKETS;
+    cache->head = NULL;
+    cache->slabs = NULL;
+    cache->slab_left = 0;
+    cache->free_entries = NULL;
+    cache->evict = NULL;
+    cache->evict_context = NULL;
+    cache->hits = 0;
+    cache->misses = 0;
+    cache->evictions = 0;
+    cache->hash = hashfunc;
+    cache->cmp = cmp;
+    cache->seed = hash_random_seed();
+
+    return cache;
+}
+
+void cache_free(Cache *cache) {
+    free_slabs(cache);
+    free(cache->buckets);
+    free(cache);
+}
+
+void cache_set_evict_callback(CacheEvictFunc evict, void *context, Cache *cache) {
+    cache->evict = evict;
+    cache->evict_context = context;
+}
+
+Value *cache_get(Key key, Cache *cache) {
+    CacheEntry **link = find_link(key, cache->hash(key, cache->seed), cache);
+
+    if (!link) {
+        cache->misses++;
+        return NULL;
+    }
+
+    CacheEntry *entry = *link;
+    cache->hits++;
+
+    if (cache->policy == CACHE_CLOCK) {
+        entry->referenced = TRUE;
+    }
+    else if (cache->head != entry) {
+        ring_unlink(entry, cache);
+        ring_insert(entry, cache);
+    }
+
+    return &(entry->value);
+}
+
+int cache_put(Key key, Value val, Cache *cache) {
+    return cache_put_weighted(key, val, 1, cache);
+}
+
+int cache_put_weighted(Key key, Value val, unsigned int cost, Cache *cache) {
+    if (cost == 0 || cost > cache->capacity) return FAILURE;
+
+    uint64_t hash = cache->hash(key, cache->seed);
+    CacheEntry **link = find_link(key, hash, cache);
+    CacheEntry *entry;
+
+    if (link) {
+        // Take the entry out of the eviction order so making room cannot pick it.
+        entry = *link;
+        ring_unlink(entry, cache);
+        cache->used -= entry->cost;
+    }
+    else {
+        entry = alloc_entry(cache);
+        if (!entry) return FAILURE;
+
+        unsigned int b = bucket_of(hash, cache->size);
+        entry->key = key;
+        entry->hash = hash;
+        entry->chain = cache->buckets[b];
+        cache->buckets[b] = entry;
+        entry->cost = 0;
+        cache->item_count++;
+    }
+
+    while (cache->capacity - cache->used < cost) cache_evict(cache);
+
+    entry->value = val;
+    entry->cost = cost;
+    entry->referenced = FALSE;
+    ring_insert(entry, cache);
+    cache->used += cost;
+
+    grow(cache);
+
+    return SUCCESS;
+}
+
+int cache_evict(Cache *cache) {
+    if (!cache->head) return FAILURE;
+
+    CacheEntry *entry = victim(cache);
+    Key key = entry->key;
+    Value value = entry->value;
+
+    drop(entry, cache);
+    cache->evictions++;
+
+    if (cache->evict) cache->evict(key, value, cache->evict_context);
+
+    return SUCCESS;
+}
+
+int cache_remove(Key key, Cache *cache) {
+    CacheEntry **link = find_link(key, cache->hash(key, cache->seed), cache);
+    if (!link) return FAILURE;
+
+    drop(*link, cache);
+    return SUCCESS;
+}
+
+int cache_contains(Key key, Cache *cache) {
+    return find_link(key, cache->hash(key, cache->seed), cache) ? TRUE : FALSE;
+}
+
+double cache_hit_rate(Cache *cache) {
+    uint64_t lookups = cache->hits + cache->misses;
+    return lookups ? (double) cache->hits / lookups : 0;
+}
+
+void cache_clear(Cache *cache) {
+    free_slabs(cache);
+    memset(cache->buckets, '\0', cache->size * sizeof(CacheEntry*));
+    cache->head = NULL;
+    cache->used = 0;
+    cache->item_count = 0;
+}
@@ -0,0 +1,222 @@
+/**
+ * @file cache.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief A bounded key-value cache with LRU or CLOCK eviction.
+ *
+ * Entries sit in a hash table, chained like the Hash Map's, and at the
+ * same time in an intrusive circular list that orders them for eviction.
+ * Every operation, eviction included, is O(1): nothing is ever searched
+ * for a victim.
+ *
+ * With LRU a hit moves its entry to the front of the list and the back
+ * entry is evicted. With CLOCK a hit only sets the entry's reference bit,
+ * and a hand sweeps the list, clearing bits, until it finds an entry that
+ * was not referenced since its last pass. CLOCK writes less on hits, LRU
+ * evicts more precisely.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_CACHE_H
+#define WESTLEY_CACHE_H
+
+#include "hashmap.h"
+
+/** Evict the least recently used entry. */
+#define CACHE_LRU 0
+
+/** Evict with the CLOCK second-chance algorithm. */
+#define CACHE_CLOCK 1
+
+/** The number of buckets a Cache starts with. */
+#define CACHE_MIN_BUCKETS 16
+
+/** The number of CacheEntries carved from each slab allocation. */
+#define CACHE_SLAB_ENTRIES 256
+
+typedef struct cacheEntry {
+    Key key;
+    Value value;
+    uint64_t hash;
+    /** The entry's share of the Cache's capacity */
+    unsigned int cost;
+    /** Set on a hit under CLOCK, cleared as the hand passes */
+    int referenced;
+    /** The next entry in the same bucket */
+    struct cacheEntry *chain;
+    /** The neighbouring entries in eviction order */
+    struct cacheEntry *prev;
+    struct cacheEntry *next;
+} CacheEntry;
+
+/**
+ * @brief A block of CacheEntries allocated at once, linked to the Cache's other slabs.
+ */
+typedef struct cacheSlab {
+    struct cacheSlab *next;
+    CacheEntry entries[CACHE_SLAB_ENTRIES];
+} CacheSlab;
+
+/**
+ * @brief Called with each entry a Cache evicts to make room.
+ */
+typedef void (*CacheEvictFunc)(Key key, Value value, void *context);
+
+/**
+ * @brief Definition of a @ref Cache.
+ */
+typedef struct cache {
+    /** The total cost the Cache may hold */
+    unsigned int capacity;
+    /** The total cost of the entries held */
+    unsigned int used;
+    /** The number of entries held */
+    unsigned int item_count;
+    /** CACHE_LRU or CACHE_CLOCK */
+    int policy;
+    /** The number of buckets */
+    unsigned int size;
+    CacheEntry **buckets;
+    /** The most recently used entry under LRU, the hand under CLOCK, NULL when empty */
+    CacheEntry *head;
+    /** The slabs CacheEntries are carved from */
+    CacheSlab *slabs;
+    /** The number of CacheEntries not yet carved from the newest slab */
+    unsigned int slab_left;
+    /** CacheEntries that were evicted or removed and can be reused, linked through chain */
+    CacheEntry *free_entries;
+    /** Called on every eviction, may be NULL */
+    CacheEvictFunc evict;
+    /** Passed to evict */
+    void *evict_context;
+    /** The number of cache_get calls that found their key */
+    uint64_t hits;
+    /** The number of cache_get calls that did not */
+    uint64_t misses;
+    /** The number of entries evicted to make room */
+    uint64_t evictions;
+    /** A function to hash keys */
+    HashFunc hash;
+    /** A function to compare keys */
+    CmpFunc cmp;
+    /** The seed passed to hash, random per Cache */
+    uint64_t seed;
+} Cache;
+
+/**
+ * @brief Allocates a new Cache for use.
+ *
+ * @param capacity The total cost of entries the Cache may hold. Entries put with cache_put cost 1.
+ * @param policy CACHE_LRU or CACHE_CLOCK.
+ * @param hashfunc The hashing function to use when inserting.
+ * @param cmp The function used to compare keys.
+ *
+ * @returns *Cache, NULL if capacity is 0 or the policy is unknown.
+ */
+Cache *cache_new(unsigned int capacity, int policy, HashFunc hashfunc, CmpFunc cmp);
+
+/**
+ * @brief Destroys a Cache and frees the memory back. No eviction callbacks are made.
+ *
+ * @param cache The Cache to free.
+ */
+void cache_free(Cache *cache);
+
+/**
+ * @brief Sets the function called with each entry evicted to make room.
+ *
+ * Removed and overwritten entries are not reported.
+ *
+ * @param evict The function to call, or NULL for none.
+ * @param context Passed through to evict.
+ * @param cache The Cache to configure.
+ */
+void cache_set_evict_callback(CacheEvictFunc evict, void *context, Cache *cache);
+
+/**
+ * @brief Looks a key up in a Cache, marking it as used.
+ *
+ * @param key The key to look for.
+ * @param cache The Cache to look through.
+ *
+ * @returns A pointer to the cached value, NULL on a miss.
+ */
+Value *cache_get(Key key, Cache *cache);
+
+/**
+ * @brief Puts a key-value pair into a Cache with a cost of 1.
+ *
+ * @param key The key to put.
+ * @param val The value to be associated with the key.
+ * @param cache The Cache to put into.
+ *
+ * @returns 1 if the pair was cached, 0 otherwise.
+ */
+int cache_put(Key key, Value val, Cache *cache);
+
+/**
+ * @brief Puts a key-value pair into a Cache, evicting entries until its cost fits.
+ *
+ * A key already present has its value and cost replaced, and counts as
+ * just used.
+ *
+ * @param key The key to put.
+ * @param val The value to be associated with the key.
+ * @param cost The entry's share of the capacity, from 1 up to the capacity.
+ * @param cache The Cache to put into.
+ *
+ * @returns 1 if the pair was cached, 0 otherwise.
+ */
+int cache_put_weighted(Key key, Value val, unsigned int cost, Cache *cache);
+
+/**
+ * @brief Evicts the entry the Cache's policy would pick next.
+ *
+ * @param cache The Cache to evict from.
+ *
+ * @returns 1 if an entry was evicted, 0 if the Cache is empty.
+ */
+int cache_evict(Cache *cache);
+
+/**
+ * @brief Removes a key (and its associated value) from a Cache.
+ *
+ * @param key The key to remove.
+ * @param cache The Cache to remove from.
+ *
+ * @returns 1 if the removal was successful, 0 otherwise.
+ */
+int cache_remove(Key key, Cache *cache);
+
+/**
+ * @brief Checks for a given key in a Cache without marking it as used or counting a hit.
+ *
+ * @param key The key to look for.
+ * @param cache The Cache to look through.
+ *
+ * @returns 1 if the key is in the Cache, 0 otherwise.
+ */
+int cache_contains(Key key, Cache *cache);
+
+/**
+ * @brief Gets the fraction of cache_get calls that were hits.
+ *
+ * @param cache The Cache to evaluate.
+ *
+ * @returns The hit rate, 0 if cache_get was never called.
+ */
+double cache_hit_rate(Cache *cache);
+
+/**
+ * @brief Removes all entries from a Cache. No eviction callbacks are made.
+ *
+ * The hit, miss and eviction counts are kept.
+ *
+ * @param cache The Cache to clear.
+ */
+void cache_clear(Cache *cache);
+
+#endif
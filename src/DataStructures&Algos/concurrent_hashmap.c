@@ -0,0 +1,456 @@
+/**
+ * @file concurrent_hashmap.c
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief A thread-safe key-value Hash Map with lock-free reads.
+ *
+ */
+
+#include "concurrent_hashmap.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <limits.h>
+
+/* Items and tables unlinked from a shard, waiting for a grace period. */
+typedef struct retiredBatch {
+    ConcurrentItem *items;
+    ConcurrentTable *tables;
+} RetiredBatch;
+
+static atomic_uint next_stripe;
+static _Thread_local unsigned int thread_stripe = UINT_MAX;
+
+static unsigned int reader_stripe(void) {
+    if (thread_stripe == UINT_MAX) {
+        thread_stripe = atomic_fetch_add(&next_stripe, 1) % CONCURRENT_READER_STRIPES;
+    }
+    return thread_stripe;
+}
+
+/*
+ * Registers the calling thread as a reader in the current epoch. Readers
+ * only touch their own stripe, so they do not contend with one another.
+ */
+static unsigned int read_lock(ConcurrentHashMap *map) {
+    unsigned int idx = atomic_load(&map->epoch) & 1;
+    atomic_fetch_add(&map->stripes[reader_stripe()].count[idx], 1);
+    return idx;
+}
+
+static void read_unlock(unsigned int idx, ConcurrentHashMap *map) {
+    atomic_fetch_sub_explicit(&map->stripes[reader_stripe()].count[idx], 1, memory_order_release);
+}
+
+static void wait_for_readers(unsigned int idx, ConcurrentHashMap *map) {
+    for (;;) {
+        long active = 0;
+        for (int i = 0; i < CONCURRENT_READER_STRIPES; i++) {
+            active += atomic_load(&map->stripes[i].count[idx]);
+        }
+        if (active == 0) return;
+        sched_yield();
+    }
+}
+
+/*
+ * Waits until every reader that may have seen an unlinked item has
+ * finished. Readers still counted in the inactive epoch are drained first,
+ * then new readers are moved to that epoch and the current one is drained.
+ * Any reader that registers after its counter was checked starts after the
+ * unlink and cannot reach the retired memory.
+ */
+static void synchronize(ConcurrentHashMap *map) {
+    pthread_mutex_lock(&map->grace_lock);
+
+    unsigned int idx = atomic_load(&map->epoch) & 1;
+    wait_for_readers(idx ^ 1, map);
+    atomic_fetch_add(&map->epoch, 1);
+    wait_for_readers(idx, map);
+
+    pthread_mutex_unlock(&map->grace_lock);
+}
+
+static void free_batch(RetiredBatch batch) {
+    while (batch.items) {
+        ConcurrentItem *next = batch.items->retired_next;
+        free(batch.items);
+        batch.items = next;
+    }
+    while (batch.tables) {
+        ConcurrentTable *next = batch.tables->retired_next;
+        free(batch.tables);
+        batch.tables = next;
+    }
+}
+
+static void retire_item(ConcurrentItem *item, ConcurrentShard *shard) {
+    item->retired_next = shard->retired_items;
+    shard->retired_items = item;
+    shard->retired_count++;
+}
+
+static void retire_table(ConcurrentTable *table, ConcurrentShard *shard) {
+    table->retired_next = shard->retired_tables;
+    shard->retired_tables = table;
+    shard->retired_count++;
+}
+
+/*
+ * Detaches the shard's retired memory once enough has built up, so it can
+ * be freed after the shard lock is released.
+ */
+static RetiredBatch take_retired(int force, ConcurrentShard *shard) {
+    RetiredBatch batch = { NULL, NULL };
+
+    if (force || shard->retired_count >= CONCURRENT_RETIRE_BATCH) {
+        batch.items = shard->retired_items;
+        batch.tables = shard->retired_tables;
+        shard->retired_items = NULL;
+        shard->retired_tables = NULL;
+        shard->retired_count = 0;
+    }
+
+    return batch;
+}
+
+static void unlock_and_reclaim(RetiredBatch batch, ConcurrentShard *shard, ConcurrentHashMap *map) {
+    pthread_mutex_unlock(&shard->lock);
+
+    if (batch.items || batch.tables) {
+        synchronize(map);
+        free_batch(batch);
+    }
+}
+
+static ConcurrentShard *shard_of(uint64_t hash, ConcurrentHashMap *map) {
+    return &map->shards[hash & (map->shard_count - 1)];
+}
+
+static unsigned int bucket_of(uint64_t hash, unsigned int size) {
+    return (unsigned int) (((hash >> 32) * size) >> 32);
+}
+
+static ConcurrentTable *table_new(unsigned int size) {
+    ConcurrentTable *table = calloc(1, sizeof(ConcurrentTable) + size * sizeof(_Atomic(ConcurrentItem *)));
+    if (!table) return NULL;
+
+    table->size = size;
+    table->retired_next = NULL;
+
+    return table;
+}
+
+static ConcurrentItem *item_new(Key key, Value val, uint64_t hash, ConcurrentItem *next) {
+    ConcurrentItem *item = malloc(sizeof(ConcurrentItem));
+    if (!item) return NULL;
+
+    item->key = key;
+    item->value = val;
+    item->hash = hash;
+    item->retired_next = NULL;
+    atomic_init(&item->next, next);
+
+    return item;
+}
+
+/*
+ * Finds the link pointing at the first item matching a key. Must be called
+ * with the shard lock held.
+ */
+static _Atomic(ConcurrentItem *) *find_link(Key key, uint64_t hash, ConcurrentTable *table, ConcurrentHashMap *map) {
+    _Atomic(ConcurrentItem *) *link = &table->buckets[bucket_of(hash, table->size)];
+    ConcurrentItem *item;
+
+    while ((item = atomic_load_explicit(link, memory_order_relaxed))) {
+        if (item->hash == hash && map->cmp(key, item->key) == 0) return link;
+        link = &item->next;
+    }
+
+    return NULL;
+}
+
+/*
+ * Copies every item of a shard into a table twice the size and publishes
+ * it. Items are copied rather than relinked so that readers still walking
+ * the old table always see complete chains.
+ */
+static void grow(ConcurrentShard *shard) {
+    ConcurrentTable *old = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    if (old->size >= UINT_MAX / 2) return;
+
+    ConcurrentTable *table = table_new(old->size * 2);
+    if (!table) return;
+
+    for (unsigned int i = 0; i < old->size; i++) {
+        ConcurrentItem *item = atomic_load_explicit(&old->buckets[i], memory_order_relaxed);
+
+        for (; item; item = atomic_load_explicit(&item->next, memory_order_relaxed)) {
+            // Appending keeps duplicate keys in their original order.
+            _Atomic(ConcurrentItem *) *link = &table->buckets[bucket_of(item->hash, table->size)];
+            while (atomic_load_explicit(link, memory_order_relaxed)) {
+                link = &atomic_load_explicit(link, memory_order_relaxed)->next;
+            }
+
+            ConcurrentItem *copy = item_new(item->key, item->value, item->hash, NULL);
+            if (!copy) {
+                RetiredBatch partial = { NULL, table };
+                for (unsigned int j = 0; j < table->size; j++) {
+                    ConcurrentItem *c = atomic_load_explicit(&table->buckets[j], memory_order_relaxed);
+                    for (; c; c = atomic_load_explicit(&c->next, memory_order_relaxed)) {
+                        c->retired_next = partial.items;
+                        partial.items = c;
+                    }
+                }
+                free_batch(partial);
+                return;
+            }
+            atomic_store_explicit(link, copy, memory_order_relaxed);
+        }
+    }
+
+    atomic_store(&shard->table, table);
+
+    for (unsigned int i = 0; i < old->size; i++) {
+        ConcurrentItem *item = atomic_load_explicit(&old->buckets[i], memory_order_relaxed);
+        while (item) {
+            ConcurrentItem *next = atomic_load_explicit(&item->next, memory_order_relaxed);
+            retire_item(item, shard);
+            item = next;
+        }
+    }
+    retire_table(old, shard);
+}
+
+ConcurrentHashMap *concurrent_hashmap_new(unsigned int size, unsigned int shards, HashFunc hashfunc, CmpFunc cmp) {
+    if (size == 0) size = HASHMAP_DEFAULT_SIZE;
+    if (shards == 0) shards = CONCURRENT_DEFAULT_SHARDS;
+    if (shards > CONCURRENT_MAX_SHARDS) shards = CONCURRENT_MAX_SHARDS;
+
+    unsigned int shard_count = 1;
+    while (shard_count < shards) shard_count *= 2;
+
+    unsigned int shard_size = size / shard_count;
+    if (shard_size < 8) shard_size = 8;
+
+    ConcurrentHashMap *map = aligned_alloc(CONCURRENT_CACHE_LINE, sizeof(ConcurrentHashMap));
+    if (!map) return NULL;
+
+    map->shards = aligned_alloc(CONCURRENT_CACHE_LINE, shard_count * sizeof(ConcurrentShard));
+    if (!map->shards) {
+        free(map);
+        return NULL;
+    }
+
+    for (unsigned int i = 0; i < shard_count; i++) {
+        ConcurrentShard *shard = &map->shards[i];
+        ConcurrentTable *table = table_new(shard_size);
+
+        if (!table) {
+            for (unsigned int j = 0; j < i; j++) {
+                free(atomic_load(&map->shards[j].table));
+                pthread_mutex_destroy(&map->shards[j].lock);
+            }
+            free(map->shards);
+            free(map);
+            return NULL;
+        }
+
+        pthread_mutex_init(&shard->lock, NULL);
+        atomic_init(&shard->table, table);
+        atomic_init(&shard->item_count, 0);
+        shard->retired_items = NULL;
+        shard->retired_tables = NULL;
+        shard->retired_count = 0;
+    }
+
+    for (int i = 0; i < CONCURRENT_READER_STRIPES; i++) {
+        atomic_init(&map->stripes[i].count[0], 0);
+        atomic_init(&map->stripes[i].count[1], 0);
+    }
+
+    atomic_init(&map->epoch, 0);
+    pthread_mutex_init(&map->grace_lock, NULL);
+    map->shard_count = shard_count;
+    map->max_load = HASHMAP_DEFAULT_LOAD;
+    map->hash = hashfunc;
+    map->cmp = cmp;
+    map->seed = hash_random_seed();
+
+    return map;
+}
+
+void concurrent_hashmap_free(ConcurrentHashMap *map) {
+    for (unsigned int i = 0; i < map->shard_count; i++) {
+        ConcurrentShard *shard = &map->shards[i];
+        ConcurrentTable *table = atomic_load(&shard->table);
+
+        for (unsigned int j = 0; j < table->size; j++) {
+            ConcurrentItem *item = atomic_load_explicit(&table->buckets[j], memory_order_relaxed);
+            while (item) {
+                ConcurrentItem *next = atomic_load_explicit(&item->next, memory_order_relaxed);
+                free(item);
+                item = next;
+            }
+        }
+        free(table);
+
+        free_batch(take_retired(TRUE, shard));
+        pthread_mutex_destroy(&shard->lock);
+    }
+
+    pthread_mutex_destroy(&map->grace_lock);
+    free(map->shards);
+    free(map);
+}
+
+static int insert_locked(Key key, Value val, uint64_t hash, int if_absent, ConcurrentHashMap *map) {
+    ConcurrentShard *shard = shard_of(hash, map);
+
+    pthread_mutex_lock(&shard->lock);
+
+    ConcurrentTable *table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+
+    if (if_absent && find_link(key, hash, table, map)) {
+        pthread_mutex_unlock(&shard->lock);
+        return FAILURE;
+    }
+
+    if (atomic_load_explicit(&shard->item_count, memory_order_relaxed) >= table->size * map->max_load) {
+        grow(shard);
+        table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    }
+
+    _Atomic(ConcurrentItem *) *bucket = &table->buckets[bucket_of(hash, table->size)];
+    ConcurrentItem *item = item_new(key, val, hash, atomic_load_explicit(bucket, memory_order_relaxed));
+
+    if (item) {
+        atomic_store(bucket, item);
+        atomic_fetch_add_explicit(&shard->item_count, 1, memory_order_relaxed);
+    }
+
+    unlock_and_reclaim(take_retired(FALSE, shard), shard, map);
+
+    return item ? SUCCESS : FAILURE;
+}
+
+int concurrent_insert(Key key, Value val, ConcurrentHashMap *map) {
+    return insert_locked(key, val, map->hash(key, map->seed), FALSE, map);
+}
+
+int concurrent_insert_if_absent(Key key, Value val, ConcurrentHashMap *map) {
+    return insert_locked(key, val, map->hash(key, map->seed), TRUE, map);
+}
+
+int concurrent_remove(Key key, ConcurrentHashMap *map) {
+    uint64_t hash = map->hash(key, map->seed);
+    ConcurrentShard *shard = shard_of(hash, map);
+
+    pthread_mutex_lock(&shard->lock);
+
+    ConcurrentTable *table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    _Atomic(ConcurrentItem *) *link = find_link(key, hash, table, map);
+
+    if (link) {
+        ConcurrentItem *item = atomic_load_explicit(link, memory_order_relaxed);
+        atomic_store(link, atomic_load_explicit(&item->next, memory_order_relaxed));
+        atomic_fetch_sub_explicit(&shard->item_count, 1, memory_order_relaxed);
+        retire_item(item, shard);
+    }
+
+    unlock_and_reclaim(take_retired(FALSE, shard), shard, map);
+
+    return link ? SUCCESS : FAILURE;
+}
+
+int concurrent_get(Key key, Value *out, ConcurrentHashMap *map) {
+    uint64_t hash = map->hash(key, map->seed);
+    ConcurrentShard *shard = shard_of(hash, map);
+    int found = FALSE;
+
+    unsigned int idx = read_lock(map);
+
+    ConcurrentTable *table = atomic_load(&shard->table);
+    ConcurrentItem *item = atomic_load(&table->buckets[bucket_of(hash, table->size)]);
+
+    for (; item; item = atomic_load(&item->next)) {
+        if (item->hash == hash && map->cmp(key, item->key) == 0) {
+            if (out) *out = item->value;
+            found = TRUE;
+            break;
+        }
+    }
+
+    read_unlock(idx, map);
+
+    return found;
+}
+
+int concurrent_set(Key key, Value new_val, ConcurrentHashMap *map) {
+    uint64_t hash = map->hash(key, map->seed);
+    ConcurrentShard *shard = shard_of(hash, map);
+    int result = FAILURE;
+
+    pthread_mutex_lock(&shard->lock);
+
+    ConcurrentTable *table = atomic_load_explicit(&shard->table, memory_order_relaxed);
+    _Atomic(ConcurrentItem *) *link = find_link(key, hash, table, map);
+
+    // Published items are never written to, so the value is replaced by
+    // swapping in an updated copy of the item.
+    if (link) {
+        ConcurrentItem *old = atomic_load_explicit(link, memory_order_relaxed);
+        ConcurrentItem *item = item_new(old->key, new_val, hash, atomic_load_explicit(&old->next, memory_order_relaxed));
+
+        if (item) {
+            atomic_store(link, item);
+            retire_item(old, shard);
+            result = SUCCESS;
+        }
+    }
+
+    unlock_and_reclaim(take_retired(FALSE, shard), shard, map);
+
+    return result;
+}
+
+int concurrent_contains(Key key, ConcurrentHashMap *map) {
+    return concurrent_get(key, NULL, map);
+}
+
+unsigned int concurrent_size(ConcurrentHashMap *map) {
+    unsigned int count = 0;
+    for (unsigned int i = 0; i < map->shard_count; i++) {
+        count += atomic_load_explicit(&map->shards[i].item_count, memory_order_relaxed);
+    }
+    return count;
+}
+
+void concurrent_clear(ConcurrentHashMap *map) {
+    for (unsigned int i = 0; i < map->shard_count; i++) {
+        ConcurrentShard *shard = &map->shards[i];
+
+        pthread_mutex_lock(&shard->lock);
+
+        ConcurrentTable *old = atomic_load_explicit(&shard->table, memory_order_relaxed);
+        ConcurrentTable *table = table_new(old->size);
+
+        if (table) {
+            atomic_store(&shard->table, table);
+            atomic_store_explicit(&shard->item_count, 0, memory_order_relaxed);
+
+            for (unsigned int j = 0; j < old->size; j++) {
+                ConcurrentItem *item = atomic_load_explicit(&old->buckets[j], memory_order_relaxed);
+                while (item) {
+                    ConcurrentItem *next = atomic_load_explicit(&item->next, memory_order_relaxed);
+                    retire_item(item, shard);
+                    item = next;
+                }
+            }
+            retire_table(old, shard);
+        }
+
+        unlock_and_reclaim(take_retired(TRUE, shard), shard, map);
+    }
+}
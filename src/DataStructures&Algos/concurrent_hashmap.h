@@ -0,0 +1,212 @@
+/**
+ * @file concurrent_hashmap.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief A thread-safe key-value Hash Map with lock-free reads.
+ *
+ * The table is split into independently locked shards, so writers to
+ * different shards never contend. Readers take no locks at all: items are
+ * never modified once published, and removed or replaced items are only
+ * freed after a grace period in which every reader that could have seen
+ * them has finished.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_CONCURRENT_HASHMAP_H
+#define WESTLEY_CONCURRENT_HASHMAP_H
+
+#include "hashmap.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+/** The number of shards used when a Concurrent Hash Map is created with 0 shards. */
+#define CONCURRENT_DEFAULT_SHARDS 64
+
+/** The most shards a Concurrent Hash Map is created with; larger requests are clamped. */
+#define CONCURRENT_MAX_SHARDS 65536
+
+/** The number of reader counters; readers are spread across them to avoid contention. */
+#define CONCURRENT_READER_STRIPES 64
+
+/** The number of retired items a shard collects before they are reclaimed together. */
+#define CONCURRENT_RETIRE_BATCH 128
+
+#define CONCURRENT_CACHE_LINE 64
+
+/**
+ * @brief An immutable key-value entry of a @ref Concurrent Hash Map.
+ */
+typedef struct concurrentItem {
+    Key key;
+    Value value;
+    uint64_t hash;
+    _Atomic(struct concurrentItem *) next;
+    /** Links the item into its shard's retired list once it is unlinked */
+    struct concurrentItem *retired_next;
+} ConcurrentItem;
+
+/**
+ * @brief The bucket array of one shard, replaced as a whole when the shard grows.
+ */
+typedef struct concurrentTable {
+    unsigned int size;
+    /** Links the table into its shard's retired list once it is replaced */
+    struct concurrentTable *retired_next;
+    _Atomic(ConcurrentItem *) buckets[];
+} ConcurrentTable;
+
+/**
+ * @brief An independently locked part of a @ref Concurrent Hash Map.
+ */
+typedef struct concurrentShard {
+    _Alignas(CONCURRENT_CACHE_LINE) pthread_mutex_t lock;
+    /** The shard's current buckets, read without the lock */
+    _Atomic(ConcurrentTable *) table;
+    /** The number of key-value pairs in the shard */
+    atomic_uint item_count;
+    /** Items unlinked from the shard but possibly still seen by readers */
+    ConcurrentItem *retired_items;
+    /** Tables replaced in the shard but possibly still seen by readers */
+    ConcurrentTable *retired_tables;
+    /** The number of entries in retired_items and retired_tables */
+    unsigned int retired_count;
+} ConcurrentShard;
+
+/**
+ * @brief Counts the readers active in each of the two reader epochs.
+ */
+typedef struct readerStripe {
+    _Alignas(CONCURRENT_CACHE_LINE) atomic_long count[2];
+} ReaderStripe;
+
+/**
+ * @brief Definition of a @ref Concurrent Hash Map.
+ */
+typedef struct concurrentHashMap {
+    /** Reader counters, summed by writers waiting for a grace period */
+    ReaderStripe stripes[CONCURRENT_READER_STRIPES];
+    /** The reader epoch, whose low bit selects the counter new readers use */
+    atomic_uint epoch;
+    /** Serialises grace periods */
+    pthread_mutex_t grace_lock;
+    /** The number of shards (a power of two) */
+    unsigned int shard_count;
+    /** The Concurrent Hash Map's shards */
+    ConcurrentShard *shards;
+    /** The ratio of items to buckets above which a shard grows */
+    float max_load;
+    /** A function to hash items into the Concurrent Hash Map */
+    HashFunc hash;
+    /** A function to compare keys in the Concurrent Hash Map */
+    CmpFunc cmp;
+    /** The seed passed to hash, random per Concurrent Hash Map */
+    uint64_t seed;
+} ConcurrentHashMap;
+
+/**
+ * @brief Allocates a new Concurrent Hash Map for use.
+ *
+ * @param size The initial number of buckets, split across the shards.
+ * @param shards The number of shards, rounded up to a power of two, at most CONCURRENT_MAX_SHARDS.
+ * @param hashfunc The hashing function to use when inserting.
+ * @param cmp The function used to compare keys.
+ *
+ * @returns *ConcurrentHashMap
+ */
+ConcurrentHashMap *concurrent_hashmap_new(unsigned int size, unsigned int shards, HashFunc hashfunc, CmpFunc cmp);
+
+/**
+ * @brief Destroys a Concurrent Hash Map and frees the memory back.
+ *
+ * No other thread may be using the map.
+ *
+ * @param map The Concurrent Hash Map to free.
+ */
+void concurrent_hashmap_free(ConcurrentHashMap *map);
+
+/**
+ * @brief Inserts a key-value pair into a Concurrent Hash Map.
+ *
+ * @param key The key to insert.
+ * @param val The value to be associated with the key.
+ * @param map The Concurrent Hash Map to insert into.
+ *
+ * @returns 1 if the insertion was successful, 0 otherwise.
+ */
+int concurrent_insert(Key key, Value val, ConcurrentHashMap *map);
+
+/**
+ * @brief Inserts a key-value pair into a Concurrent Hash Map if the key is not already present.
+ *
+ * @param key The key to insert.
+ * @param val The value to be associated with the key.
+ * @param map The Concurrent Hash Map to insert into.
+ *
+ * @returns 1 if the insertion was successful, 0 otherwise.
+ */
+int concurrent_insert_if_absent(Key key, Value val, ConcurrentHashMap *map);
+
+/**
+ * @brief Removes a key (and its associated value) from a Concurrent Hash Map.
+ *
+ * @param key The key to remove.
+ * @param map The Concurrent Hash Map to remove from.
+ *
+ * @returns 1 if the removal was successful, 0 otherwise.
+ */
+int concurrent_remove(Key key, ConcurrentHashMap *map);
+
+/**
+ * @brief Gets a copy of the value associated to a key, without taking any lock.
+ *
+ * @param key The key to look for.
+ * @param out Where to copy the value, may be NULL.
+ * @param map The Concurrent Hash Map to look through.
+ *
+ * @returns 1 if the key was found, 0 otherwise.
+ */
+int concurrent_get(Key key, Value *out, ConcurrentHashMap *map);
+
+/**
+ * @brief Sets a key's value in a Concurrent Hash Map.
+ *
+ * @param key The key to set.
+ * @param new_val The new value.
+ * @param map The Concurrent Hash Map.
+ *
+ * @returns 1 if the value was successfully set, 0 otherwise.
+ */
+int concurrent_set(Key key, Value new_val, ConcurrentHashMap *map);
+
+/**
+ * @brief Checks for a given key in a Concurrent Hash Map, without taking any lock.
+ *
+ * @param key The key to look for.
+ * @param map The Concurrent Hash Map to look through.
+ *
+ * @returns 1 if the key is in the Concurrent Hash Map, 0 otherwise.
+ */
+int concurrent_contains(Key key, ConcurrentHashMap *map);
+
+/**
+ * @brief Counts the key-value pairs in a Concurrent Hash Map.
+ *
+ * The count is exact only when no writer is running.
+ *
+ * @param map The Concurrent Hash Map to evaluate.
+ *
+ * @returns The number of key-value pairs.
+ */
+unsigned int concurrent_size(ConcurrentHashMap *map);
+
+/**
+ * @brief Removes all key-value pairs from a Concurrent Hash Map.
+ *
+ * @param map The Concurrent Hash Map to clear.
+ */
+void concurrent_clear(ConcurrentHashMap *map);
+
+#endif
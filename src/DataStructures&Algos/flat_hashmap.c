@@ -0,0 +1,300 @@
+/**
+ * @file flat_hashmap.c
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief An open-addressing key-value Hash Map with SIMD group probing.
+ *
+ */
+
+#include "flat_hashmap.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define CTRL_EMPTY ((signed char) -128)
+#define CTRL_DELETED ((signed char) -2)
+
+/* Tables are kept at most 7/8 full so probe sequences stay short. */
+#define MAX_LOAD_NUM 7
+#define MAX_LOAD_DEN 8
+
+/* The largest power of two an unsigned int capacity can double up to. */
+#define MAX_CAPACITY (UINT_MAX / 2 + 1)
+
+static uint64_t full_hash(Key key, FlatHashMap *map) {
+    return map->hash(key, map->seed);
+}
+
+static uint64_t h1(uint64_t hash) {
+    return hash >> 7;
+}
+
+static signed char h2(uint64_t hash) {
+    return (signed char) (hash & 0x7F);
+}
+
+#ifdef __SSE2__
+
+static unsigned int group_match(const signed char *ctrl, signed char byte) {
+    __m128i group = _mm_loadu_si128((const __m128i *) ctrl);
+    return (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(byte)));
+}
+
+static unsigned int group_match_free(const signed char *ctrl) {
+    // EMPTY and DELETED are the only control bytes with the sign bit set.
+    return (unsigned int) _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) ctrl));
+}
+
+#else
+
+static unsigned int group_match(const signed char *ctrl, signed char byte) {
+    unsigned int mask = 0;
+    for (int i = 0; i < FLAT_GROUP_WIDTH; i++) {
+        if (ctrl[i] == byte) mask |= 1u << i;
+    }
+    return mask;
+}
+
+static unsigned int group_match_free(const signed char *ctrl) {
+    unsigned int mask = 0;
+    for (int i = 0; i < FLAT_GROUP_WIDTH; i++) {
+        if (ctrl[i] < 0) mask |= 1u << i;
+    }
+    return mask;
+}
+
+#endif
+
+static unsigned int group_match_empty(const signed char *ctrl) {
+    return group_match(ctrl, CTRL_EMPTY);
+}
+
+static unsigned int max_items(unsigned int capacity) {
+    return capacity / MAX_LOAD_DEN * MAX_LOAD_NUM;
+}
+
+/*
+ * Returns the smallest capacity that holds size items, 0 when even
+ * MAX_CAPACITY is too small.
+ */
+static unsigned int capacity_for(unsigned int size) {
+    unsigned int capacity = FLAT_GROUP_WIDTH;
+    while (max_items(capacity) < size) {
+        if (capacity == MAX_CAPACITY) return 0;
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+static int allocate_table(unsigned int capacity, FlatHashMap *map) {
+    signed char *ctrl = malloc(capacity);
+    if (!ctrl) return FAILURE;
+
+    FlatSlot *slots = malloc(capacity * sizeof(FlatSlot));
+    if (!slots) {
+        free(ctrl);
+        return FAILURE;
+    }
+
+    memset(ctrl, CTRL_EMPTY, capacity);
+
+    map->ctrl = ctrl;
+    map->slots = slots;
+    map->capacity = capacity;
+    map->growth_left = max_items(capacity);
+
+    return SUCCESS;
+}
+
+/*
+ * Finds the first EMPTY or DELETED slot along the probe sequence of a hash.
+ * Groups are probed with triangular strides, which visits every group once
+ * when the number of groups is a power of two.
+ */
+static unsigned int find_free_slot(uint64_t hash, FlatHashMap *map) {
+    unsigned int group_mask = map->capacity / FLAT_GROUP_WIDTH - 1;
+    unsigned int group = (unsigned int) (h1(hash) & group_mask);
+
+    for (unsigned int stride = 1; ; stride++) {
+        const signed char *ctrl = map->ctrl + group * FLAT_GROUP_WIDTH;
+        unsigned int free_mask = group_match_free(ctrl);
+        if (free_mask) return group * FLAT_GROUP_WIDTH + __builtin_ctz(free_mask);
+        group = (group + stride) & group_mask;
+    }
+}
+
+/*
+ * Finds the slot holding a key, or -1 if the key is absent. The probe stops
+ * at the first group that still has an EMPTY slot, since an insert would
+ * have used it rather than moving on.
+ */
+static long find_slot(Key key, uint64_t hash, FlatHashMap *map) {
+    unsigned int group_mask = map->capacity / FLAT_GROUP_WIDTH - 1;
+    unsigned int group = (unsigned int) (h1(hash) & group_mask);
+    signed char fragment = h2(hash);
+
+    for (unsigned int stride = 1; stride <= group_mask + 1; stride++) {
+        const signed char *ctrl = map->ctrl + group * FLAT_GROUP_WIDTH;
+        unsigned int match = group_match(ctrl, fragment);
+
+        while (match) {
+            unsigned int slot = group * FLAT_GROUP_WIDTH + __builtin_ctz(match);
+            if (map->cmp(key, map->slots[slot].key) == 0) return slot;
+            match &= match - 1;
+        }
+
+        if (group_match_empty(ctrl)) return -1;
+        group = (group + stride) & group_mask;
+    }
+
+    return -1;
+}
+
+static void place(unsigned int slot, uint64_t hash, Key key, Value val, FlatHashMap *map) {
+    if (map->ctrl[slot] == CTRL_EMPTY) map->growth_left--;
+    map->ctrl[slot] = h2(hash);
+    map->slots[slot].key = key;
+    map->slots[slot].value = val;
+}
+
+/*
+ * Moves every entry into a fresh table. Tables that are mostly tombstones are
+ * rebuilt at the same capacity, otherwise the capacity doubles.
+ */
+static int rehash(FlatHashMap *map) {
+    signed char *old_ctrl = map->ctrl;
+    FlatSlot *old_slots = map->slots;
+    unsigned int old_capacity = map->capacity;
+
+    unsigned int new_capacity = old_capacity;
+    if (map->item_count >= max_items(old_capacity) / 2) {
+        if (old_capacity == MAX_CAPACITY) return FAILURE;
+        new_capacity *= 2;
+    }
+
+    if (!allocate_table(new_capacity, map)) {
+        map->ctrl = old_ctrl;
+        map->slots = old_slots;
+        map->capacity = old_capacity;
+        return FAILURE;
+    }
+
+    for (unsigned int i = 0; i < old_capacity; i++) {
+        if (old_ctrl[i] < 0) continue;
+        uint64_t hash = full_hash(old_slots[i].key, map);
+        place(find_free_slot(hash, map), hash, old_slots[i].key, old_slots[i].value, map);
+    }
+
+    free(old_ctrl);
+    free(old_slots);
+
+    return SUCCESS;
+}
+
+FlatHashMap *flat_hashmap_new(unsigned int size, HashFunc hashfunc, CmpFunc cmp) {
+    FlatHashMap *map = malloc(sizeof(FlatHashMap));
+    if (!map) return NULL;
+
+    unsigned int capacity = capacity_for(size);
+    if (!capacity || !allocate_table(capacity, map)) {
+        free(map);
+        return NULL;
+    }
+
+    map->item_count = 0;
+    map->hash = hashfunc;
+    map->cmp = cmp;
+    map->seed = hash_random_seed();
+
+    return map;
+}
+
+void flat_hashmap_free(FlatHashMap *map) {
+    free(map->ctrl);
+    free(map->slots);
+    free(map);
+}
+
+int flat_insert(Key key, Value val, FlatHashMap *map) {
+    uint64_t hash = full_hash(key, map);
+    unsigned int slot = find_free_slot(hash, map);
+
+    if (map->growth_left == 0 && map->ctrl[slot] == CTRL_EMPTY) {
+        if (!rehash(map)) return FAILURE;
+        slot = find_free_slot(hash, map);
+    }
+
+    place(slot, hash, key, val, map);
+    map->item_count++;
+
+    return SUCCESS;
+}
+
+int flat_insert_if_absent(Key key, Value val, FlatHashMap *map) {
+    uint64_t hash = full_hash(key, map);
+
+    if (find_slot(key, hash, map) != -1) return FAILURE;
+
+    unsigned int slot = find_free_slot(hash, map);
+
+    if (map->growth_left == 0 && map->ctrl[slot] == CTRL_EMPTY) {
+        if (!rehash(map)) return FAILURE;
+        slot = find_free_slot(hash, map);
+    }
+
+    place(slot, hash, key, val, map);
+    map->item_count++;
+
+    return SUCCESS;
+}
+
+int flat_remove(Key key, FlatHashMap *map) {
+    long slot = find_slot(key, full_hash(key, map), map);
+    if (slot == -1) return FAILURE;
+
+    // A slot may go straight back to EMPTY when its group still has an EMPTY
+    // slot: no probe sequence can have passed through this group.
+    const signed char *group = map->ctrl + (slot / FLAT_GROUP_WIDTH) * FLAT_GROUP_WIDTH;
+    if (group_match_empty(group)) {
+        map->ctrl[slot] = CTRL_EMPTY;
+        map->growth_left++;
+    }
+    else {
+        map->ctrl[slot] = CTRL_DELETED;
+    }
+    map->item_count--;
+
+    return SUCCESS;
+}
+
+Value *flat_get(Key key, FlatHashMap *map) {
+    long slot = find_slot(key, full_hash(key, map), map);
+    return slot == -1 ? NULL : &(map->slots[slot].value);
+}
+
+int flat_set(Key key, Value new_val, FlatHashMap *map) {
+    Value *val = flat_get(key, map);
+    if (!val) return FAILURE;
+
+    *val = new_val;
+    return SUCCESS;
+}
+
+int flat_contains(Key key, FlatHashMap *map) {
+    return flat_get(key, map) ? TRUE : FALSE;
+}
+
+int flat_empty(FlatHashMap *map) {
+    return map->item_count == 0 ? TRUE : FALSE;
+}
+
+void flat_clear(FlatHashMap *map) {
+    memset(map->ctrl, CTRL_EMPTY, map->capacity);
+    map->item_count = 0;
+    map->growth_left = max_items(map->capacity);
+}
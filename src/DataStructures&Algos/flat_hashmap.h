@@ -0,0 +1,153 @@
+/**
+ * @file flat_hashmap.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief An open-addressing key-value Hash Map with SIMD group probing.
+ *
+ * Entries live in one flat slot array rather than in chained HashItems.
+ * Every slot has a control byte holding either EMPTY, DELETED or the low
+ * 7 bits of the key's 64-bit hash, so a group of 16 slots can be filtered
+ * with a single SSE2 compare before any key comparison is made.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_FLAT_HASHMAP_H
+#define WESTLEY_FLAT_HASHMAP_H
+
+#include "hashmap.h"
+
+/** The number of slots probed together with one SIMD compare. */
+#define FLAT_GROUP_WIDTH 16
+
+/**
+ * @brief A single key-value slot of a @ref Flat Hash Map.
+ */
+typedef struct flatSlot {
+    Key key;
+    Value value;
+} FlatSlot;
+
+/**
+ * @brief Definition of a @ref Flat Hash Map.
+ */
+typedef struct flatHashMap {
+    /** The number of slots in the Flat Hash Map (a power of two) */
+    unsigned int capacity;
+    /** The number of key-value pairs in the Flat Hash Map */
+    unsigned int item_count;
+    /** The number of inserts left before the Flat Hash Map must grow */
+    unsigned int growth_left;
+    /** One control byte per slot: EMPTY, DELETED or a 7-bit hash fragment */
+    signed char *ctrl;
+    /** The Flat Hash Map's slots */
+    FlatSlot *slots;
+    /** A function to hash items into the Flat Hash Map */
+    HashFunc hash;
+    /** A function to compare keys in the Flat Hash Map */
+    CmpFunc cmp;
+    /** The seed passed to hash, random per Flat Hash Map */
+    uint64_t seed;
+} FlatHashMap;
+
+/**
+ * @brief Allocates a new Flat Hash Map for use.
+ *
+ * @param size The number of items to make room for up front.
+ * @param hashfunc The hashing function to use when inserting.
+ * @param cmp The function used to compare keys.
+ *
+ * @returns *FlatHashMap, NULL if size is more than any table can hold or memory ran out.
+ */
+FlatHashMap *flat_hashmap_new(unsigned int size, HashFunc hashfunc, CmpFunc cmp);
+
+/**
+ * @brief Destroys a Flat Hash Map and frees the memory back.
+ *
+ * @param map The Flat Hash Map to free.
+ */
+void flat_hashmap_free(FlatHashMap *map);
+
+/**
+ * @brief Inserts a key-value pair into a Flat Hash Map.
+ *
+ * @param key The key to insert.
+ * @param val The value to be associated with the key.
+ * @param map The Flat Hash Map to insert into.
+ *
+ * @returns 1 if the insertion was successful, 0 otherwise.
+ */
+int flat_insert(Key key, Value val, FlatHashMap *map);
+
+/**
+ * @brief Inserts a key-value pair into a Flat Hash Map if the key is not already present.
+ *
+ * @param key The key to insert.
+ * @param val The value to be associated with the key.
+ * @param map The Flat Hash Map to insert into.
+ *
+ * @returns 1 if the insertion was successful, 0 otherwise.
+ */
+int flat_insert_if_absent(Key key, Value val, FlatHashMap *map);
+
+/**
+ * @brief Removes a key (and its associated value) from a Flat Hash Map.
+ *
+ * @param key The key to remove.
+ * @param map The Flat Hash Map to remove from.
+ *
+ * @returns 1 if the removal was successful, 0 otherwise.
+ */
+int flat_remove(Key key, FlatHashMap *map);
+
+/**
+ * @brief Gets the associated value to a key in a Flat Hash Map.
+ *
+ * @param key The key to look for.
+ * @param map The Flat Hash Map to look through.
+ *
+ * @returns A pointer to found value, NULL if the value does not exist.
+ *          The pointer is invalidated by the next insert.
+ */
+Value *flat_get(Key key, FlatHashMap *map);
+
+/**
+ * @brief Sets a key's value in a Flat Hash Map.
+ *
+ * @param key The key to set.
+ * @param new_val The new value.
+ * @param map The Flat Hash Map.
+ *
+ * @returns 1 if the value was successfully set, 0 otherwise.
+ */
+int flat_set(Key key, Value new_val, FlatHashMap *map);
+
+/**
+ * @brief Checks for a given key in a Flat Hash Map.
+ *
+ * @param key The key to look for.
+ * @param map The Flat Hash Map to look through.
+ *
+ * @returns 1 if the key is in the Flat Hash Map, 0 otherwise.
+ */
+int flat_contains(Key key, FlatHashMap *map);
+
+/**
+ * @brief Checks if a Flat Hash Map is empty.
+ *
+ * @param map The Flat Hash Map to evaluate.
+ *
+ * @returns 1 if the Flat Hash Map is empty, 0 otherwise.
+ */
+int flat_empty(FlatHashMap *map);
+
+/**
+ * @brief Removes all key-value pairs from a Flat Hash Map.
+ *
+ * @param map The Flat Hash Map to clear.
+ */
+void flat_clear(FlatHashMap *map);
+
+#endif
@@ -0,0 +1,340 @@
+/**
+ * @file frozen_hashmap.c
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief An immutable key-value map built on a minimal perfect hash.
+ *
+ */
+
+#include "frozen_hashmap.h"
+#include <stdlib.h>
+#include <string.h>
+
+/* An item of the source Hash Map, numbered in the order get would find it. */
+typedef struct frozenSource {
+    uint64_t hash;
+    unsigned int seq;
+    HashItem *item;
+} FrozenSource;
+
+static int by_hash(const void *a, const void *b) {
+    const FrozenSource *x = a, *y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    return (x->seq > y->seq) - (x->seq < y->seq);
+}
+
+static unsigned int reduce(uint64_t x, unsigned int range) {
+    return (unsigned int) (((x >> 32) * range) >> 32);
+}
+
+/*
+ * Assigns keys to buckets unevenly, as PTHash does: 60% of keys go to the
+ * first 30% of buckets. Those dense buckets are placed while the table is
+ * still mostly empty, which leaves mostly singletons for the crowded end.
+ */
+static unsigned int bucket_of(uint64_t g, unsigned int bucket_count) {
+    unsigned int dense = (unsigned int) (bucket_count * 0.3);
+    if (dense == 0 || dense == bucket_count) return reduce(g, bucket_count);
+
+    if ((uint32_t) g < (uint32_t) (0.6 * 4294967296.0)) return reduce(g, dense);
+    return dense + reduce(g, bucket_count - dense);
+}
+
+static unsigned int place_of(uint64_t g, unsigned int pilot, unsigned int table_size) {
+    return reduce(hash_u64(g, pilot), table_size);
+}
+
+static unsigned int get_pilot(unsigned int bucket, FrozenHashMap *map) {
+    uint64_t bit = (uint64_t) bucket * map->pilot_width;
+    uint64_t word = bit >> 6;
+    unsigned int offset = bit & 63;
+
+    uint64_t value = map->pilots[word] >> offset;
+    if (offset + map->pilot_width > 64) value |= map->pilots[word + 1] << (64 - offset);
+
+    return (unsigned int) (value & ((1ULL << map->pilot_width) - 1));
+}
+
+static void set_pilot(unsigned int bucket, unsigned int pilot, FrozenHashMap *map) {
+    uint64_t bit = (uint64_t) bucket * map->pilot_width;
+    uint64_t word = bit >> 6;
+    unsigned int offset = bit & 63;
+
+    map->pilots[word] |= (uint64_t) pilot << offset;
+    if (offset + map->pilot_width > 64) map->pilots[word + 1] |= (uint64_t) pilot >> (64 - offset);
+}
+
+/*
+ * Gathers the Hash Map's items in the order get would find them, sorts them
+ * by hash and drops shadowed duplicates. Returns the number kept, or -1 if
+ * two distinct keys share a full hash, which no perfect hash can separate.
+ */
+static long collect(HashMap *map, FrozenSource **out) {
+    FrozenSource *items = malloc((map->item_count + 1) * sizeof(FrozenSource));
+    if (!items) return -1;
+
+    unsigned int count = 0;
+    HashItem **tables[2] = { map->buckets, map->old_buckets };
+    unsigned int sizes[2] = { map->size, map->old_size };
+
+    for (int t = 0; t < 2; t++) {
+        if (!tables[t]) continue;
+        for (unsigned int i = 0; i < sizes[t]; i++) {
+            for (HashItem *item = tables[t][i]; item; item = item->next) {
+                items[count].hash = item->hash;
+                items[count].seq = count;
+                items[count].item = item;
+                count++;
+            }
+        }
+    }
+
+    qsort(items, count, sizeof(FrozenSource), by_hash);
+
+    unsigned int kept = 0;
+    for (unsigned int i = 0; i < count; ) {
+        unsigned int group = kept;
+        unsigned int j = i;
+
+        for (; j < count && items[j].hash == items[i].hash; j++) {
+            int shadowed = FALSE;
+            for (unsigned int k = group; k < kept; k++) {
+                if (map->cmp(items[j].item->key, items[k].item->key) == 0) shadowed = TRUE;
+            }
+            if (!shadowed) items[kept++] = items[j];
+        }
+
+        if (kept - group > 1) {
+            free(items);
+            return -1;
+        }
+        i = j;
+    }
+
+    *out = items;
+    return kept;
+}
+
+/*
+ * Searches a pilot for every bucket, largest buckets first, so that all
+ * keys land on distinct places in [0, table_size).
+ */
+static int search_pilots(uint64_t *g, unsigned int n, unsigned int *places, FrozenHashMap *map) {
+    unsigned int nb = map->bucket_count;
+    unsigned int m = map->table_size;
+    int result = FAILURE;
+
+    unsigned int *start = calloc(nb + 1, sizeof(unsigned int));
+    unsigned int *members = malloc((n + 1) * sizeof(unsigned int));
+    unsigned int *pilot_of = calloc(nb, sizeof(unsigned int));
+    uint64_t *taken = calloc(m / 64 + 1, sizeof(uint64_t));
+    unsigned int *order = malloc(nb * sizeof(unsigned int));
+
+    if (!start || !members || !pilot_of || !taken || !order) goto done;
+
+    // Group keys by bucket with a counting sort.
+    for (unsigned int i = 0; i < n; i++) start[bucket_of(g[i], nb) + 1]++;
+    for (unsigned int b = 0; b < nb; b++) start[b + 1] += start[b];
+
+    unsigned int max_size = 0;
+    {
+        unsigned int *fill = calloc(nb, sizeof(unsigned int));
+        if (!fill) goto done;
+        for (unsigned int i = 0; i < n; i++) {
+            unsigned int b = bucket_of(g[i], nb);
+            members[start[b] + fill[b]++] = i;
+        }
+        for (unsigned int b = 0; b < nb; b++) {
+            if (fill[b] > max_size) max_size = fill[b];
+        }
+        free(fill);
+    }
+
+    // Order buckets by decreasing size, again with a counting sort.
+    {
+        unsigned int *by_size = calloc(max_size + 2, sizeof(unsigned int));
+        if (!by_size) goto done;
+        for (unsigned int b = 0; b < nb; b++) by_size[max_size - (start[b + 1] - start[b]) + 1]++;
+        for (unsigned int s = 0; s <= max_size; s++) by_size[s + 1] += by_size[s];
+        for (unsigned int b = 0; b < nb; b++) order[by_size[max_size - (start[b + 1] - start[b])]++] = b;
+        free(by_size);
+    }
+
+    unsigned int max_pilot = 0;
+
+    for (unsigned int o = 0; o < nb; o++) {
+        unsigned int b = order[o];
+        unsigned int size = start[b + 1] - start[b];
+        if (size == 0) break;
+
+        unsigned int pilot;
+        for (pilot = 0; pilot < FROZEN_MAX_PILOT; pilot++) {
+            unsigned int j;
+            for (j = 0; j < size; j++) {
+                unsigned int k = members[start[b] + j];
+                unsigned int p = place_of(g[k], pilot, m);
+                if (taken[p >> 6] & (1ULL << (p & 63))) break;
+                // Claim tentatively so that keys of the same bucket collide.
+                taken[p >> 6] |= 1ULL << (p & 63);
+                places[k] = p;
+            }
+            if (j == size) break;
+
+            for (unsigned int u = 0; u < j; u++) {
+                unsigned int p = places[members[start[b] + u]];
+                taken[p >> 6] &= ~(1ULL << (p & 63));
+            }
+        }
+
+        if (pilot == FROZEN_MAX_PILOT) goto done;
+
+        pilot_of[b] = pilot;
+        if (pilot > max_pilot) max_pilot = pilot;
+    }
+
+    map->pilot_width = 1;
+    while (map->pilot_width < 32 && (max_pilot >> map->pilot_width)) map->pilot_width++;
+
+    map->pilots = calloc((uint64_t) nb * map->pilot_width / 64 + 2, sizeof(uint64_t));
+    if (!map->pilots) goto done;
+
+    for (unsigned int b = 0; b < nb; b++) set_pilot(b, pilot_of[b], map);
+
+    // Places at or above n are redirected to the slots below n left free.
+    unsigned int free_slot = 0;
+    for (unsigned int p = n; p < m; p++) {
+        if (!(taken[p >> 6] & (1ULL << (p & 63)))) continue;
+        while (taken[free_slot >> 6] & (1ULL << (free_slot & 63))) free_slot++;
+        map->remap[p - n] = free_slot++;
+    }
+
+    result = SUCCESS;
+
+done:
+    free(start);
+    free(members);
+    free(pilot_of);
+    free(taken);
+    free(order);
+    return result;
+}
+
+#ifdef HASHMAP_OWNED_KEYS
+
+/*
+ * Copies the key strings, which live in the source Hash Map's slabs and
+ * key blocks, into one block of the Frozen Hash Map's own, in slot order.
+ */
+static int copy_keys(FrozenHashMap *frozen) {
+    size_t total = 0;
+    for (unsigned int i = 0; i < frozen->item_count; i++) total += strlen(frozen->keys[i]) + 1;
+
+    frozen->key_data = malloc(total ? total : 1);
+    if (!frozen->key_data) return FAILURE;
+
+    char *next = frozen->key_data;
+    for (unsigned int i = 0; i < frozen->item_count; i++) {
+        size_t length = strlen(frozen->keys[i]) + 1;
+        memcpy(next, frozen->keys[i], length);
+        frozen->keys[i] = next;
+        next += length;
+    }
+    return SUCCESS;
+}
+
+#endif
+
+FrozenHashMap *hashmap_freeze(HashMap *map) {
+    FrozenSource *items;
+    long count = collect(map, &items);
+    if (count < 0) return NULL;
+
+    unsigned int n = (unsigned int) count;
+
+    FrozenHashMap *frozen = calloc(1, sizeof(FrozenHashMap));
+    uint64_t *g = malloc((n + 1) * sizeof(uint64_t));
+    unsigned int *places = malloc((n + 1) * sizeof(unsigned int));
+
+    if (!frozen || !g || !places) goto fail;
+
+    frozen->item_count = n;
+    frozen->table_size = n + n / 100 + 1;
+    frozen->bucket_count = n / FROZEN_BUCKET_LOAD + 1;
+    // Unused places stay mapped to slot 0, where a missing key is rejected by cmp.
+    frozen->remap = calloc(frozen->table_size - n, sizeof(unsigned int));
+    frozen->keys = malloc((n + 1) * sizeof(Key));
+    frozen->values = malloc((n + 1) * sizeof(Value));
+    frozen->hash = map->hash;
+    frozen->cmp = map->cmp;
+    frozen->seed = map->seed;
+
+    if (!frozen->remap || !frozen->keys || !frozen->values) goto fail;
+
+    int built = FALSE;
+    for (int attempt = 0; attempt < FROZEN_MAX_ATTEMPTS && !built; attempt++) {
+        frozen->build_seed = hash_random_seed();
+        for (unsigned int i = 0; i < n; i++) g[i] = hash_u64(items[i].hash, frozen->build_seed);
+        built = search_pilots(g, n, places, frozen);
+    }
+    if (!built) goto fail;
+
+    for (unsigned int i = 0; i < n; i++) {
+        unsigned int slot = places[i] < n ? places[i] : frozen->remap[places[i] - n];
+        frozen->keys[slot] = items[i].item->key;
+        frozen->values[slot] = items[i].item->value;
+    }
+
+#ifdef HASHMAP_OWNED_KEYS
+    if (!copy_keys(frozen)) goto fail;
+#endif
+
+    free(items);
+    free(g);
+    free(places);
+
+    return frozen;
+
+fail:
+    if (frozen) {
+        free(frozen->pilots);
+        free(frozen->remap);
+        free(frozen->keys);
+        free(frozen->values);
+#ifdef HASHMAP_OWNED_KEYS
+        free(frozen->key_data);
+#endif
+        free(frozen);
+    }
+    free(items);
+    free(g);
+    free(places);
+    return NULL;
+}
+
+void frozen_hashmap_free(FrozenHashMap *map) {
+    free(map->pilots);
+    free(map->remap);
+    free(map->keys);
+    free(map->values);
+#ifdef HASHMAP_OWNED_KEYS
+    free(map->key_data);
+#endif
+    free(map);
+}
+
+Value *frozen_get(Key key, FrozenHashMap *map) {
+    if (map->item_count == 0) return NULL;
+
+    uint64_t g = hash_u64(map->hash(key, map->seed), map->build_seed);
+    unsigned int pilot = get_pilot(bucket_of(g, map->bucket_count), map);
+    unsigned int slot = place_of(g, pilot, map->table_size);
+
+    if (slot >= map->item_count) slot = map->remap[slot - map->item_count];
+
+    return map->cmp(key, map->keys[slot]) == 0 ? &(map->values[slot]) : NULL;
+}
+
+int frozen_contains(Key key, FrozenHashMap *map) {
+    return frozen_get(key, map) ? TRUE : FALSE;
+}
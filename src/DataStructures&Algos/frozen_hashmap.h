@@ -0,0 +1,112 @@
+/**
+ * @file frozen_hashmap.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief An immutable key-value map built on a minimal perfect hash.
+ *
+ * A Frozen Hash Map is built once from a populated Hash Map and can then
+ * only be read. Keys are split into small buckets, and each bucket stores a
+ * "pilot" that was searched for at build time so that every key lands in a
+ * distinct slot (PTHash-style). A lookup hashes the key, reads one pilot
+ * and checks one slot, with no chains or probing.
+ *
+ * Pilots are bit-packed at the width of the largest one. With about six
+ * keys per bucket the structure costs under 3 bits per key on top of the
+ * keys and values.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_FROZEN_HASHMAP_H
+#define WESTLEY_FROZEN_HASHMAP_H
+
+#include "hashmap.h"
+
+/** The average number of keys sharing a pilot. */
+#define FROZEN_BUCKET_LOAD 6
+
+/** The number of pilots tried for a bucket before the build is retried with a new seed. */
+#define FROZEN_MAX_PILOT (1u << 24)
+
+/** The number of seeds tried before freezing gives up. */
+#define FROZEN_MAX_ATTEMPTS 8
+
+/**
+ * @brief Definition of a @ref Frozen Hash Map.
+ */
+typedef struct frozenHashMap {
+    /** The number of key-value pairs, which is also the number of slots */
+    unsigned int item_count;
+    /** The size of the range keys are first placed in, slightly above item_count */
+    unsigned int table_size;
+    /** The number of pilot buckets */
+    unsigned int bucket_count;
+    /** The width of each packed pilot in bits */
+    unsigned int pilot_width;
+    /** The bit-packed pilots, one per bucket */
+    uint64_t *pilots;
+    /** Maps places at or above item_count onto the free slots below it */
+    unsigned int *remap;
+    /** The keys, one per slot */
+    Key *keys;
+#ifdef HASHMAP_OWNED_KEYS
+    /** The Frozen Hash Map's own copies of the key strings, which keys point into */
+    char *key_data;
+#endif
+    /** The values, one per slot */
+    Value *values;
+    /** The function used to hash keys, shared with the source Hash Map */
+    HashFunc hash;
+    /** The function used to compare keys, shared with the source Hash Map */
+    CmpFunc cmp;
+    /** The seed passed to hash, copied from the source Hash Map */
+    uint64_t seed;
+    /** The seed that the pilots were searched for under */
+    uint64_t build_seed;
+} FrozenHashMap;
+
+/**
+ * @brief Builds an immutable perfect-hash map from the contents of a Hash Map.
+ *
+ * When the Hash Map holds a key more than once, the value get would return
+ * is kept. The Hash Map is left untouched and may be freed afterwards.
+ * Under HASHMAP_OWNED_KEYS the key strings are copied, as the Hash Map
+ * frees its own copies with it; otherwise the keys are shared, and must
+ * outlive the Frozen Hash Map.
+ *
+ * @param map The Hash Map to freeze.
+ *
+ * @returns *FrozenHashMap, NULL if memory ran out or no perfect hash was found.
+ */
+FrozenHashMap *hashmap_freeze(HashMap *map);
+
+/**
+ * @brief Destroys a Frozen Hash Map and frees the memory back.
+ *
+ * @param map The Frozen Hash Map to free.
+ */
+void frozen_hashmap_free(FrozenHashMap *map);
+
+/**
+ * @brief Gets the associated value to a key in a Frozen Hash Map.
+ *
+ * @param key The key to look for.
+ * @param map The Frozen Hash Map to look through.
+ *
+ * @returns A pointer to found value, NULL if the value does not exist.
+ */
+Value *frozen_get(Key key, FrozenHashMap *map);
+
+/**
+ * @brief Checks for a given key in a Frozen Hash Map.
+ *
+ * @param key The key to look for.
+ * @param map The Frozen Hash Map to look through.
+ *
+ * @returns 1 if the key is in the Frozen Hash Map, 0 otherwise.
+ */
+int frozen_contains(Key key, FrozenHashMap *map);
+
+#endif
@@ -0,0 +1,135 @@
+/**
+ * @file hash.c
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief Fast, seeded, non-cryptographic 64-bit hash functions.
+ *
+ */
+
+#define _DEFAULT_SOURCE
+#include "hash.h"
+#include <string.h>
+#include <time.h>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+/* Odd constants with well spread bits, as used by wyhash. */
+#define P0 0xa0761d6478bd642fULL
+#define P1 0xe7037ed1a0b428dbULL
+#define P2 0x8ebc6af09c88c6e3ULL
+#define P3 0x589965cc75374cc3ULL
+
+/*
+ * Multiplies two 64-bit words into 128 bits and folds the halves together.
+ */
+static uint64_t mum(uint64_t a, uint64_t b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t) a * b;
+    return (uint64_t) r ^ (uint64_t) (r >> 64);
+#else
+    uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t) a, lb = (uint32_t) b;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+    return lo ^ hi;
+#endif
+}
+
+static uint64_t read64(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+static uint64_t read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+/* Reads 1 to 3 bytes without branching on the exact length. */
+static uint64_t read_small(const unsigned char *p, size_t k) {
+    return (((uint64_t) p[0]) << 16) | (((uint64_t) p[k >> 1]) << 8) | p[k - 1];
+}
+
+uint64_t hash_bytes(const void *data, size_t length, uint64_t seed) {
+    const unsigned char *p = data;
+    uint64_t a, b;
+
+    seed ^= mum(seed ^ P0, P1);
+
+    if (length <= 16) {
+        if (length >= 4) {
+            a = (read32(p) << 32) | read32(p + ((length >> 3) << 2));
+            b = (read32(p + length - 4) << 32) | read32(p + length - 4 - ((length >> 3) << 2));
+        }
+        else if (length > 0) {
+            a = read_small(p, length);
+            b = 0;
+        }
+        else {
+            a = b = 0;
+        }
+    }
+    else {
+        size_t i = length;
+
+        if (i > 48) {
+            uint64_t see1 = seed, see2 = seed;
+            do {
+                seed = mum(read64(p) ^ P1, read64(p + 8) ^ seed);
+                see1 = mum(read64(p + 16) ^ P2, read64(p + 24) ^ see1);
+                see2 = mum(read64(p + 32) ^ P3, read64(p + 40) ^ see2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= see1 ^ see2;
+        }
+
+        while (i > 16) {
+            seed = mum(read64(p) ^ P1, read64(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+
+        a = read64(p + i - 16);
+        b = read64(p + i - 8);
+    }
+
+    return mum(P1 ^ length, mum(a ^ P1, b ^ seed));
+}
+
+uint64_t hash_string(const char *str, uint64_t seed) {
+    return hash_bytes(str, strlen(str), seed);
+}
+
+uint64_t hash_u64(uint64_t key, uint64_t seed) {
+    return mum(mum(key ^ P0, seed ^ P1), P2 ^ 8);
+}
+
+uint64_t hash_double(double key, uint64_t seed) {
+    uint64_t bits;
+    if (key == 0) key = 0;
+    memcpy(&bits, &key, sizeof(bits));
+    return hash_u64(bits, seed);
+}
+
+uint64_t hash_random_seed(void) {
+    static uint64_t counter = 0;
+    uint64_t seed = 0;
+
+#if defined(__linux__) || defined(__APPLE__)
+    if (getentropy(&seed, sizeof(seed)) == 0) return seed;
+#endif
+
+    // Without an entropy source, mix whatever varies between calls and runs.
+    seed = hash_u64((uint64_t) time(NULL), (uint64_t) clock());
+    seed = hash_u64(seed ^ (uint64_t) (uintptr_t) &seed, ++counter);
+
+    return seed;
+}
@@ -0,0 +1,71 @@
+/**
+ * @file hash.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief Fast, seeded, non-cryptographic 64-bit hash functions.
+ *
+ * Byte strings are consumed eight bytes at a time and folded with 64x64->128
+ * bit multiplies, which gives full avalanche at a few cycles per word.
+ * Every function takes a seed, so a map hashing with a random seed cannot
+ * be flooded with keys chosen to collide.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_HASH_H
+#define WESTLEY_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Hashes a block of bytes.
+ *
+ * @param data The bytes to hash.
+ * @param length The number of bytes to hash.
+ * @param seed The seed to hash with.
+ *
+ * @returns The 64-bit hash of the bytes.
+ */
+uint64_t hash_bytes(const void *data, size_t length, uint64_t seed);
+
+/**
+ * @brief Hashes a NUL-terminated string.
+ *
+ * @param str The string to hash.
+ * @param seed The seed to hash with.
+ *
+ * @returns The 64-bit hash of the string.
+ */
+uint64_t hash_string(const char *str, uint64_t seed);
+
+/**
+ * @brief Hashes a 64-bit integer.
+ *
+ * @param key The integer to hash.
+ * @param seed The seed to hash with.
+ *
+ * @returns The 64-bit hash of the integer.
+ */
+uint64_t hash_u64(uint64_t key, uint64_t seed);
+
+/**
+ * @brief Hashes a double, so that 0.0 and -0.0 hash alike.
+ *
+ * @param key The double to hash.
+ * @param seed The seed to hash with.
+ *
+ * @returns The 64-bit hash of the double.
+ */
+uint64_t hash_double(double key, uint64_t seed);
+
+/**
+ * @brief Produces a fresh random seed, drawn from the operating system where possible.
+ *
+ * @returns A 64-bit seed.
+ */
+uint64_t hash_random_seed(void);
+
+#endif
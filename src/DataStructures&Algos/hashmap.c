@@ -8,36 +8,358 @@
  */
 
 #include "hashmap.h"
+#include "bloom_filter.h"
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
 
-int default_char_hash(char key, int length) {
-    return ((int) key) % length;
+uint64_t default_char_hash(char key, uint64_t seed) {
+    return hash_u64((unsigned char) key, seed);
 }
 
-int default_string_hash(char *key, int length) {
-    long int hash = 0;
-    int p = 2;
-    int n = 0;
+uint64_t default_string_hash(char *key, uint64_t seed) {
+    return hash_string(key, seed);
+}
+
+uint64_t default_int_hash(int key, uint64_t seed) {
+    return hash_u64((uint64_t) key, seed);
+}
+
+uint64_t default_double_hash(double key, uint64_t seed) {
+    return hash_double(key, seed);
+}
+
+/*
+ * Maps a hash onto [0, size) with a multiply rather than a division,
+ * using the hash's high bits.
+ */
+static unsigned int bucket_of(uint64_t hash, unsigned int size) {
+    return (unsigned int) (((hash >> 32) * size) >> 32);
+}
+
+static int rehashing(HashMap *map) {
+    return map->old_buckets != NULL;
+}
+
+/*
+ * Takes a HashItem from the free list, or carves one from the newest slab,
+ * allocating a fresh slab when it is used up.
+ */
+static HashItem *alloc_item(HashMap *map) {
+    if (map->free_items) {
+        HashItem *item = map->free_items;
+        map->free_items = item->next;
+        return item;
+    }
+
+    if (map->slab_left == 0) {
+        HashSlab *slab = malloc(sizeof(HashSlab));
+        if (!slab) return NULL;
+
+        slab->next = map->slabs;
+        map->slabs = slab;
+        map->slab_left = HASHMAP_SLAB_ITEMS;
+    }
+
+    return &map->slabs->items[HASHMAP_SLAB_ITEMS - map->slab_left--];
+}
+
+static void free_item(HashItem *item, HashMap *map) {
+    item->next = map->free_items;
+    map->free_items = item;
+}
+
+static void free_slabs(HashMap *map) {
+    HashSlab *current = map->slabs;
+    HashSlab *prev;
+    while (current)
+    {
+        prev = current;
+        current = current->next;
+        free(prev);
+    }
+    map->slabs = NULL;
+    map->slab_left = 0;
+    map->free_items = NULL;
+}
+
+#ifdef HASHMAP_OWNED_KEYS
+
+/*
+ * Copies a key into the Hash Map. Short keys go inline in the entry, which
+ * never moves since it lives in a slab. Longer keys are bump-allocated
+ * from the newest key block, or get a block of their own when very long.
+ */
+static int own_key(HashItem *entry, HashMap *map) {
+    size_t length = strlen(entry->key) + 1;
+
+    if (length <= HASHMAP_INLINE_KEY) {
+        memcpy(entry->key_inline, entry->key, length);
+        entry->key = entry->key_inline;
+        return SUCCESS;
+    }
+
+    if (length > map->key_left) {
+        size_t block_size = length > HASHMAP_KEY_BLOCK ? length : HASHMAP_KEY_BLOCK;
+        HashKeyBlock *block = malloc(sizeof(HashKeyBlock) + block_size);
+        if (!block) return FAILURE;
+
+        block->next = map->key_blocks;
+        map->key_blocks = block;
+        map->key_next = block->data;
+        map->key_left = block_size;
+    }
+
+    memcpy(map->key_next, entry->key, length);
+    entry->key = map->key_next;
+    map->key_next += length;
+    map->key_left -= length;
+
+    return SUCCESS;
+}
+
+static void free_keys(HashMap *map) {
+    HashKeyBlock *current = map->key_blocks;
+    HashKeyBlock *prev;
+    while (current)
+    {
+        prev = current;
+        current = current->next;
+        free(prev);
+    }
+    map->key_blocks = NULL;
+    map->key_next = NULL;
+    map->key_left = 0;
+}
+
+#endif
+
+/*
+ * Appends an item to the end of its chain in the new table, so items keep
+ * their relative order (newest first) when moved out of the old table.
+ */
+static void move_item(HashItem *item, HashMap *map) {
+    HashItem **link = &map->buckets[bucket_of(item->hash, map->size)];
+    while (*link) link = &(*link)->next;
+    item->next = NULL;
+    *link = item;
+}
+
+/*
+ * Moves up to steps non-empty buckets from the old table to the new one.
+ * Runs of empty buckets are bounded too, so a sparse old table cannot
+ * make a single call slow.
+ */
+static void rehash_step(unsigned int steps, HashMap *map) {
+    unsigned int empty_visits = HASHMAP_REHASH_STEP * 10;
+
+    while (steps > 0 && map->rehash_index < map->old_size) {
+        HashItem *current = map->old_buckets[map->rehash_index];
+
+        if (!current) {
+            map->rehash_index++;
+            if (--empty_visits == 0) break;
+            continue;
+        }
+
+        while (current) {
+            HashItem *next = current->next;
+            move_item(current, map);
+            current = next;
+        }
+        map->old_buckets[map->rehash_index++] = NULL;
+        steps--;
+    }
+
+    if (map->rehash_index >= map->old_size) {
+        free(map->old_buckets);
+        map->old_buckets = NULL;
+        map->old_size = 0;
+        map->rehash_index = 0;
+    }
+}
+
+static void finish_rehash(HashMap *map) {
+    while (rehashing(map)) rehash_step(map->old_size, map);
+}
+
+static int start_rehash(unsigned int new_size, HashMap *map) {
+    HashItem **buckets = calloc(new_size, sizeof(HashItem*));
+    if (!buckets) return FAILURE;
+
+    map->old_buckets = map->buckets;
+    map->old_size = map->size;
+    map->rehash_index = 0;
+    map->buckets = buckets;
+    map->size = new_size;
+
+    return SUCCESS;
+}
+
+/*
+ * Advances an ongoing rehash, or starts one when the load factor has been
+ * crossed. Failing to grow is not an error: the map keeps working, only
+ * with longer chains.
+ */
+static void maintain(HashMap *map) {
+    if (rehashing(map)) {
+        rehash_step(HASHMAP_REHASH_STEP, map);
+    }
+    else if (map->item_count >= map->size * map->max_load && map->size < UINT_MAX / 2) {
+        start_rehash(map->size * 2, map);
+    }
+}
+
+/*
+ * Rebuilds the Bloom filter from the items present, sized for twice as
+ * many so that it absorbs a doubling before the next rebuild.
+ */
+static int build_filter(double bits_per_key, HashMap *map) {
+    unsigned int capacity = map->item_count < UINT_MAX / 2 ? 2 * map->item_count : UINT_MAX;
+    if (capacity < HASHMAP_DEFAULT_SIZE) capacity = HASHMAP_DEFAULT_SIZE;
+
+    BloomFilter *filter = bloom_filter_new(capacity, bits_per_key);
+    if (!filter) return FAILURE;
+
+    HashItem **tables[2] = { map->buckets, map->old_buckets };
+    unsigned int sizes[2] = { map->size, map->old_size };
+
+    for (int t = 0; t < 2; t++) {
+        if (!tables[t]) continue;
+        for (unsigned int i = 0; i < sizes[t]; i++) {
+            for (HashItem *item = tables[t][i]; item; item = item->next) bloom_add(item->hash, filter);
+        }
+    }
+
+    if (map->filter) bloom_filter_free(map->filter);
+    map->filter = filter;
+    map->filter_bits = bits_per_key;
+    map->filter_stale = 0;
+
+    return SUCCESS;
+}
+
+/*
+ * Rebuilds the Bloom filter once the Hash Map has outgrown it, or once the
+ * removed keys it still holds are half its capacity. Failing to rebuild is
+ * not an error: the old filter never misses a present key.
+ */
+static void refresh_filter(HashMap *map) {
+    BloomFilter *filter = map->filter;
+    if (map->item_count > filter->capacity || map->filter_stale > filter->capacity / 2) {
+        build_filter(map->filter_bits, map);
+    }
+}
+
+static int filtered_out(uint64_t hash, HashMap *map) {
+    return map->filter && !bloom_may_contain(hash, map->filter);
+}
+
+static int keys_match(Key key, HashItem *item, HashMap *map) {
+#ifdef HASHMAP_COUNTERS
+    map->counters.cmp_calls += map->counters.sampling;
+#endif
+    return map->cmp(key, item->key) == 0;
+}
 
-    while (key[n]) {
-        hash += ((int) key[n]) * pow(p, n);
-        n++;
+/*
+ * Finds the link pointing at the first item matching a key in a chain.
+ * Cached hashes are compared first, so cmp is only called on likely matches.
+ */
+static HashItem **find_link(Key key, uint64_t hash, HashItem **link, HashMap *map) {
+    while (*link) {
+        if ((*link)->hash == hash && keys_match(key, *link, map)) return link;
+        link = &(*link)->next;
+    }
+    return NULL;
+}
+
+/*
+ * Finds the first item matching a key. The new table holds the most recent
+ * inserts, so it is searched before the table being drained.
+ */
+static HashItem *search(Key key, uint64_t hash, HashMap *map) {
+    if (filtered_out(hash, map)) return NULL;
+
+    HashItem **link = find_link(key, hash, &map->buckets[bucket_of(hash, map->size)], map);
+    if (link) return *link;
+
+    if (rehashing(map)) {
+        link = find_link(key, hash, &map->old_buckets[bucket_of(hash, map->old_size)], map);
+        if (link) return *link;
     }
 
-    return hash % length;
+    return NULL;
 }
 
-int default_int_hash(int key, int length) {
-    return abs(key) % length;
+#ifdef HASHMAP_COUNTERS
+
+/*
+ * Draws the number of lookups until the next sample, averaging
+ * HASHMAP_SAMPLE_RATE. The gaps are random so that a periodic access
+ * pattern cannot line up with the samples and skew the counts.
+ */
+static unsigned int next_gap(HashMapCounters *counters) {
+    counters->rng ^= counters->rng << 13;
+    counters->rng ^= counters->rng >> 7;
+    counters->rng ^= counters->rng << 17;
+    return 1 + (unsigned int) (counters->rng % (2 * HASHMAP_SAMPLE_RATE - 1));
 }
 
-int default_double_hash(double key, int length) {
-    return abs((int) key) % length;
+/*
+ * Searches for a key, recording the lookup if it is due to be sampled.
+ * The cmp calls of removals are never sampled.
+ */
+static HashItem *find_item(Key key, uint64_t hash, HashMap *map) {
+    HashMapCounters *counters = &map->counters;
+    counters->sampling = --counters->countdown == 0;
+    if (counters->sampling) counters->countdown = next_gap(counters);
+
+    HashItem *item = search(key, hash, map);
+
+    if (counters->sampling) {
+        counters->lookups++;
+        if (!item) counters->misses++;
+        counters->sampling = 0;
+    }
+
+    return item;
+}
+
+#else
+
+static HashItem *find_item(Key key, uint64_t hash, HashMap *map) {
+    return search(key, hash, map);
+}
+
+#endif
+
+static int remove_from(Key key, uint64_t hash, HashItem **bucket, int limit, HashMap *map) {
+    int removed = 0;
+    HashItem **link = bucket;
+
+    while (removed != limit && (link = find_link(key, hash, link, map))) {
+        HashItem *current = *link;
+        *link = current->next;
+        free_item(current, map);
+        map->item_count--;
+        removed++;
+    }
+
+    if (removed && map->filter) {
+        map->filter_stale += removed;
+        refresh_filter(map);
+    }
+
+    return removed;
 }
 
 HashMap *hashmap_new(unsigned int size, HashFunc hashfunc, CmpFunc cmp) {
+    if (size == 0) size = HASHMAP_DEFAULT_SIZE;
+
     HashMap *map = malloc(sizeof(HashMap));
     if (!map) return NULL;
 
@@ -49,136 +371,261 @@ HashMap *hashmap_new(unsigned int size, HashFunc hashfunc, CmpFunc cmp) {
 
     map->size = size;
     map->item_count = 0;
+    map->old_buckets = NULL;
+    map->old_size = 0;
+    map->rehash_index = 0;
+    map->max_load = HASHMAP_DEFAULT_LOAD;
+    map->slabs = NULL;
+    map->slab_left = 0;
+    map->free_items = NULL;
+#ifdef HASHMAP_OWNED_KEYS
+    map->key_blocks = NULL;
+    map->key_next = NULL;
+    map->key_left = 0;
+#endif
     map->hash = hashfunc;
     map->cmp = cmp;
+    map->seed = hash_random_seed();
+    map->filter = NULL;
+    map->filter_bits = 0;
+    map->filter_stale = 0;
+#ifdef HASHMAP_COUNTERS
+    memset(&map->counters, 0, sizeof(HashMapCounters));
+    map->counters.rng = map->seed | 1;
+    map->counters.countdown = next_gap(&map->counters);
+#endif
 
     return map;
 }
 
-void hashmap_free(HashMap *map) {
-    for (int i = 0; i < map->size; i++)
-    {
-        HashItem *current = map->buckets[i];
-        HashItem *prev;
-        while (current)
-        {
-            prev = current;
-            current = current->next;
-            free(prev);
-        }
+int hashmap_set_load_factor(float load, HashMap *map) {
+    if (!(load > 0)) return FAILURE;
+
+    map->max_load = load;
+    return SUCCESS;
+}
+
+int hashmap_reserve(unsigned int count, HashMap *map) {
+    finish_rehash(map);
+
+    double needed = ceil(count / map->max_load);
+    if (needed <= map->size) return SUCCESS;
+    if (needed > UINT_MAX) return FAILURE;
+
+    if (!start_rehash((unsigned int) needed, map)) return FAILURE;
+    finish_rehash(map);
+
+    return SUCCESS;
+}
+
+int hashmap_attach_filter(double bits_per_key, HashMap *map) {
+    if (!(bits_per_key >= 1)) return FAILURE;
+
+    return build_filter(bits_per_key, map);
+}
+
+void hashmap_detach_filter(HashMap *map) {
+    if (!map->filter) return;
+
+    bloom_filter_free(map->filter);
+    map->filter = NULL;
+    map->filter_stale = 0;
+}
+
+static void count_chains(HashItem **buckets, unsigned int from, unsigned int to, HashMapStats *out) {
+    for (unsigned int i = from; i < to; i++) {
+        unsigned int length = 0;
+        for (HashItem *item = buckets[i]; item; item = item->next) length++;
+
+        out->histogram[length < HASHMAP_STATS_BINS ? length : HASHMAP_STATS_BINS - 1]++;
+        if (length > out->max_chain) out->max_chain = length;
+        // The items of a chain cost 1, 2, ..., length visits to find.
+        out->average_probe += (double) length * (length + 1) / 2;
+    }
+}
+
+void hashmap_stats(HashMap *map, HashMapStats *out) {
+    memset(out, 0, sizeof(HashMapStats));
+
+    count_chains(map->buckets, 0, map->size, out);
+    // Buckets of the old table below rehash_index have already been moved.
+    if (rehashing(map)) count_chains(map->old_buckets, map->rehash_index, map->old_size, out);
+
+    out->bucket_count = map->size + (rehashing(map) ? map->old_size - map->rehash_index : 0);
+    out->item_count = map->item_count;
+    out->empty_ratio = (double) out->histogram[0] / out->bucket_count;
+    out->load_factor = (double) map->item_count / out->bucket_count;
+    out->average_probe = map->item_count ? out->average_probe / map->item_count : 0;
+
+    out->memory = sizeof(HashMap) + ((size_t) map->size + map->old_size) * sizeof(HashItem*);
+    for (HashSlab *slab = map->slabs; slab; slab = slab->next) out->memory += sizeof(HashSlab);
+    if (map->filter) out->memory += sizeof(BloomFilter) + (size_t) map->filter->block_count * BLOOM_BLOCK_BITS / 8;
+#ifdef HASHMAP_OWNED_KEYS
+    // Oversized keys get blocks of their own, so this undercounts them.
+    for (HashKeyBlock *block = map->key_blocks; block; block = block->next) {
+        out->memory += sizeof(HashKeyBlock) + HASHMAP_KEY_BLOCK;
     }
+#endif
+
+#ifdef HASHMAP_COUNTERS
+    out->lookups = map->counters.lookups * HASHMAP_SAMPLE_RATE;
+    out->misses = map->counters.misses * HASHMAP_SAMPLE_RATE;
+    out->cmp_calls = map->counters.cmp_calls * HASHMAP_SAMPLE_RATE;
+#endif
+}
+
+void hashmap_free(HashMap *map) {
+    hashmap_detach_filter(map);
+    free_slabs(map);
+#ifdef HASHMAP_OWNED_KEYS
+    free_keys(map);
+#endif
+    free(map->old_buckets);
     free(map->buckets);
     free(map);
 }
 
-int insert(Key key, Value val, HashMap *map) {
-    HashItem *entry = malloc(sizeof(HashItem));
+static int link_item(Key key, Value val, uint64_t hash, HashMap *map) {
+    HashItem *entry = alloc_item(map);
     if (!entry) return FAILURE;
 
-    int loc = map->hash(key, map->size);
+    unsigned int loc = bucket_of(hash, map->size);
 
     entry->key = key;
     entry->value = val;
+    entry->hash = hash;
+
+#ifdef HASHMAP_OWNED_KEYS
+    if (!own_key(entry, map)) {
+        free_item(entry, map);
+        return FAILURE;
+    }
+#endif
+
     entry->next = map->buckets[loc];
     map->buckets[loc] = entry;
     map->item_count++;
 
+    if (map->filter) {
+        bloom_add(hash, map->filter);
+        refresh_filter(map);
+    }
+
     return SUCCESS;
 }
 
-int insert_if_absent(Key key, Value val, HashMap *map) {
-    HashItem *entry = malloc(sizeof(HashItem));
-    if (!entry)
-        return FAILURE;
-
-    int loc = map->hash(key, map->size);
+int insert(Key key, Value val, HashMap *map) {
+    maintain(map);
 
-    HashItem *current = map->buckets[loc];
+    return link_item(key, val, map->hash(key, map->seed), map);
+}
 
-    while (current && current->next) {
-        if (cmp(key, current->key) == 0) return FAILURE;
-        current = current->next;
-    }
+int insert_if_absent(Key key, Value val, HashMap *map) {
+    maintain(map);
 
-    entry->key = key;
-    entry->value = val;
-    entry->next = map->buckets[loc];
-    map->buckets[loc] = entry;
-    map->item_count++;
+    uint64_t hash = map->hash(key, map->seed);
+    if (find_item(key, hash, map)) return FAILURE;
 
-    return SUCCESS;
+    return link_item(key, val, hash, map);
 }
 
 int remove(Key key, HashMap *map) {
-    int loc = map->hash(key, map->size);
+    uint64_t hash = map->hash(key, map->seed);
+    if (filtered_out(hash, map)) return FAILURE;
 
-    HashItem *current = map->buckets[loc];
-    HashItem *prev;
+    if (remove_from(key, hash, &map->buckets[bucket_of(hash, map->size)], 1, map)) return SUCCESS;
 
-    while (current && current->next)
-    {
-        if (cmp(key, current->key) == 0) {
-            prev->next = current->next;
-            free(current);
-            map->item_count--;
-            return SUCCESS;
-        }
-        prev = current;
-        current = current->next;
+    if (rehashing(map) && remove_from(key, hash, &map->old_buckets[bucket_of(hash, map->old_size)], 1, map)) {
+        return SUCCESS;
     }
 
     return FAILURE;
 }
 
 int remove_all(Key key, HashMap *map) {
-    int loc = map->hash(key, map->size);
+    uint64_t hash = map->hash(key, map->seed);
+    if (filtered_out(hash, map)) return 0;
+    int removed = remove_from(key, hash, &map->buckets[bucket_of(hash, map->size)], -1, map);
 
-    HashItem *current = map->buckets[loc];
-    HashItem *prev;
+    if (rehashing(map)) {
+        removed += remove_from(key, hash, &map->old_buckets[bucket_of(hash, map->old_size)], -1, map);
+    }
 
-    int begin_count = map->item_count;
+    return removed;
+}
 
-    while (current && current->next)
-    {
-        if (cmp(key, current->key) == 0)
-        {
-            prev->next = current->next;
-            free(current);
-            map->item_count--;
-        }
-        prev = current;
-        current = current->next;
+Value *get(Key key, HashMap *map) {
+    if (rehashing(map)) rehash_step(HASHMAP_REHASH_STEP, map);
+
+    HashItem *item = find_item(key, map->hash(key, map->seed), map);
+    return item ? &(item->value) : NULL;
+}
+
+/*
+ * Looks up one group of keys in three passes: hash every key and prefetch
+ * its bucket slot, then load each bucket head and prefetch the first item,
+ * then walk the chains. By the time a chain is walked its first item has
+ * usually arrived in cache.
+ */
+static unsigned int get_group(Key *keys, unsigned int count, Value **out, HashMap *map) {
+    uint64_t hashes[HASHMAP_BATCH_GROUP];
+    unsigned int found = 0;
+
+    for (unsigned int i = 0; i < count; i++) {
+        hashes[i] = map->hash(keys[i], map->seed);
+        __builtin_prefetch(&map->buckets[bucket_of(hashes[i], map->size)]);
+        if (rehashing(map)) __builtin_prefetch(&map->old_buckets[bucket_of(hashes[i], map->old_size)]);
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        HashItem *head = map->buckets[bucket_of(hashes[i], map->size)];
+        if (head) __builtin_prefetch(head);
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        HashItem *item = find_item(keys[i], hashes[i], map);
+        out[i] = item ? &(item->value) : NULL;
+        if (item) found++;
     }
 
-    return begin_count - map->item_count;
+    return found;
 }
 
-Value *get(Key key, HashMap *map) {
-    int loc = map->hash(key, map->size);
+unsigned int hashmap_get_batch(Key *keys, unsigned int count, Value **out, HashMap *map) {
+    unsigned int found = 0;
 
-    HashItem *current = map->buckets[loc];
+    for (unsigned int i = 0; i < count; i += HASHMAP_BATCH_GROUP) {
+        if (rehashing(map)) rehash_step(HASHMAP_REHASH_STEP, map);
 
-    while (current && current->next) {
-        if (map->cmp(key, current->key) == 0) return &(current->value);
+        unsigned int n = count - i < HASHMAP_BATCH_GROUP ? count - i : HASHMAP_BATCH_GROUP;
+        found += get_group(keys + i, n, out + i, map);
     }
 
-    return NULL;
+    return found;
 }
 
-int set(Key key, Value new_val, HashMap *map) {
-    int loc = map->hash(key, map->size);
+unsigned int hashmap_contains_batch(Key *keys, unsigned int count, int *out, HashMap *map) {
+    Value *values[HASHMAP_BATCH_GROUP];
+    unsigned int found = 0;
 
-    HashItem *current = map->buckets[loc];
+    for (unsigned int i = 0; i < count; i += HASHMAP_BATCH_GROUP) {
+        unsigned int n = count - i < HASHMAP_BATCH_GROUP ? count - i : HASHMAP_BATCH_GROUP;
+        found += hashmap_get_batch(keys + i, n, values, map);
 
-    while (current && current->next)
-    {
-        if (map->cmp(key, current->key) == 0) {
-            current->value = new_val;
-            return SUCCESS;
+        for (unsigned int j = 0; j < n; j++) {
+            out[i + j] = values[j] ? TRUE : FALSE;
         }
     }
 
-    return FAILURE;
+    return found;
+}
+
+int set(Key key, Value new_val, HashMap *map) {
+    Value *val = get(key, map);
+    if (!val) return FAILURE;
+
+    *val = new_val;
+    return SUCCESS;
 }
 
 int contains(Key key, HashMap *map) {
@@ -190,17 +637,487 @@ int empty(HashMap *map) {
 }
 
 void clear(HashMap *map) {
-    for (int i = 0; i < map->size; i++)
-    {
-        HashItem *current = map->buckets[i];
-        HashItem *prev;
-        while (current)
-        {
-            prev = current;
-            current = current->next;
-            free(prev);
-        }
-    }
+    free_slabs(map);
+#ifdef HASHMAP_OWNED_KEYS
+    free_keys(map);
+#endif
     memset(map->buckets, '\0', map->size * sizeof(HashItem*));
+
+    if (rehashing(map)) {
+        free(map->old_buckets);
+        map->old_buckets = NULL;
+        map->old_size = 0;
+        map->rehash_index = 0;
+    }
+
     map->item_count = 0;
-}
\ No newline at end of file
+
+    if (map->filter) {
+        bloom_filter_clear(map->filter);
+        map->filter_stale = 0;
+    }
+}
+
+/* A pair scattered into its partition by hashmap_build. */
+typedef struct buildSlot {
+    uint64_t hash;
+    unsigned int index;
+} BuildSlot;
+
+/* One thread's share of hashmap_build. */
+typedef struct buildTask {
+    HashMap *map;
+    Key *keys;
+    Value *values;
+    uint64_t *hashes;
+    BuildSlot *slots;
+    unsigned int parts;
+    /* The input pairs this thread hashes and scatters */
+    unsigned int from;
+    unsigned int to;
+    /* The number of this thread's pairs in each partition, then where the next one goes */
+    unsigned int *offsets;
+    /* The slots of the partition this thread links */
+    unsigned int slot_from;
+    unsigned int slot_to;
+    /* Allocates this thread's items, only its slabs and key blocks are used */
+    HashMap arena;
+    unsigned int linked;
+    int failed;
+} BuildTask;
+
+/* One thread's share of hashmap_group_by. */
+typedef struct groupTask {
+    HashMap *map;
+    Key *keys;
+    Value *values;
+    int aggregate;
+    unsigned int parts;
+    unsigned int from;
+    unsigned int to;
+    /* The private Hash Map this thread's input is aggregated into */
+    HashMap *local;
+    /* The items of local, chained through next, one chain per partition */
+    HashItem **chains;
+    /* The index of the partition this thread merges */
+    unsigned int part;
+    struct groupTask *all;
+    /* Takes the items found to be duplicates while merging */
+    HashMap arena;
+    unsigned int linked;
+    int failed;
+} GroupTask;
+
+static unsigned int worker_count(unsigned int threads, unsigned int count) {
+    if (threads == 0) {
+        long online = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = online > 0 ? (unsigned int) online : 1;
+    }
+
+    unsigned int useful = count / HASHMAP_PARALLEL_GRAIN;
+    if (threads > useful) threads = useful;
+    if (threads > HASHMAP_MAX_THREADS) threads = HASHMAP_MAX_THREADS;
+
+    return threads ? threads : 1;
+}
+
+/*
+ * Runs work on count tasks, the first on the calling thread. A task whose
+ * thread cannot be started is run on the calling thread instead.
+ */
+static void run_tasks(void *(*work)(void *), void *tasks, size_t task_size, unsigned int count) {
+    pthread_t threads[HASHMAP_MAX_THREADS];
+    int started[HASHMAP_MAX_THREADS];
+
+    for (unsigned int i = 1; i < count; i++) {
+        void *task = (char *) tasks + i * task_size;
+        started[i] = pthread_create(&threads[i], NULL, work, task) == 0;
+        if (!started[i]) work(task);
+    }
+
+    work(tasks);
+
+    for (unsigned int i = 1; i < count; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+    }
+}
+
+/*
+ * Sizes a table for count items as a multiple of parts buckets. Since
+ * bucket_of is monotonic in the hash, bucket_of(hash, parts) is then
+ * bucket_of(hash, size) / (size / parts), and each partition owns a
+ * contiguous run of size / parts buckets.
+ */
+static unsigned int partitioned_size(unsigned int count, unsigned int parts, float load) {
+    double needed = ceil(count / load);
+    if (needed < HASHMAP_DEFAULT_SIZE) needed = HASHMAP_DEFAULT_SIZE;
+
+    double per_part = ceil(needed / parts);
+    if (per_part * parts > UINT_MAX) per_part = UINT_MAX / parts;
+
+    return (unsigned int) per_part * parts;
+}
+
+static int resize_buckets(unsigned int size, HashMap *map) {
+    HashItem **buckets = calloc(size, sizeof(HashItem*));
+    if (!buckets) return FAILURE;
+
+    free(map->buckets);
+    map->buckets = buckets;
+    map->size = size;
+
+    return SUCCESS;
+}
+
+/*
+ * Hands the slabs and key blocks of a thread's allocator over to a Hash
+ * Map. They are spliced in behind the Hash Map's newest slab and key
+ * block, so its slab_left and key_left stay valid; items not yet carved
+ * from the thread's newest slab join the free list instead.
+ */
+static void adopt_memory(HashMap *from, HashMap *map) {
+    if (from->slabs) {
+        while (from->slab_left) free_item(&from->slabs->items[HASHMAP_SLAB_ITEMS - from->slab_left--], map);
+
+        HashSlab *tail = from->slabs;
+        while (tail->next) tail = tail->next;
+
+        if (map->slabs) {
+            tail->next = map->slabs->next;
+            map->slabs->next = from->slabs;
+        }
+        else map->slabs = from->slabs;
+    }
+
+    while (from->free_items) {
+        HashItem *item = from->free_items;
+        from->free_items = item->next;
+        free_item(item, map);
+    }
+
+#ifdef HASHMAP_OWNED_KEYS
+    if (from->key_blocks) {
+        HashKeyBlock *tail = from->key_blocks;
+        while (tail->next) tail = tail->next;
+
+        if (map->key_blocks) {
+            tail->next = map->key_blocks->next;
+            map->key_blocks->next = from->key_blocks;
+        }
+        else map->key_blocks = from->key_blocks;
+    }
+
+    from->key_blocks = NULL;
+    from->key_next = NULL;
+    from->key_left = 0;
+#endif
+
+    from->slabs = NULL;
+    from->slab_left = 0;
+}
+
+static void free_arena(HashMap *arena) {
+    free_slabs(arena);
+#ifdef HASHMAP_OWNED_KEYS
+    free_keys(arena);
+#endif
+}
+
+static void *hash_chunk(void *arg) {
+    BuildTask *task = arg;
+    HashMap *map = task->map;
+
+    for (unsigned int i = task->from; i < task->to; i++) {
+        uint64_t hash = map->hash(task->keys[i], map->seed);
+        task->hashes[i] = hash;
+        task->offsets[bucket_of(hash, task->parts)]++;
+    }
+
+    return NULL;
+}
+
+/*
+ * Scatters a thread's pairs into their partitions. The partitions are laid
+ * out thread by thread, so every partition keeps the input's order.
+ */
+static void *scatter_chunk(void *arg) {
+    BuildTask *task = arg;
+
+    for (unsigned int i = task->from; i < task->to; i++) {
+        uint64_t hash = task->hashes[i];
+        BuildSlot *slot = &task->slots[task->offsets[bucket_of(hash, task->parts)]++];
+        slot->hash = hash;
+        slot->index = i;
+    }
+
+    return NULL;
+}
+
+/*
+ * Links the items of one partition into its own run of buckets. Pairs are
+ * linked in input order at the head of their chains, as insert does.
+ */
+static void *link_partition(void *arg) {
+    BuildTask *task = arg;
+    HashMap *map = task->map;
+
+    for (unsigned int s = task->slot_from; s < task->slot_to; s++) {
+        HashItem *entry = alloc_item(&task->arena);
+        if (!entry) {
+            task->failed = TRUE;
+            return NULL;
+        }
+
+        BuildSlot *slot = &task->slots[s];
+        entry->key = task->keys[slot->index];
+        entry->value = task->values[slot->index];
+        entry->hash = slot->hash;
+
+#ifdef HASHMAP_OWNED_KEYS
+        if (!own_key(entry, &task->arena)) {
+            task->failed = TRUE;
+            return NULL;
+        }
+#endif
+
+        HashItem **bucket = &map->buckets[bucket_of(slot->hash, map->size)];
+        entry->next = *bucket;
+        *bucket = entry;
+        task->linked++;
+    }
+
+    return NULL;
+}
+
+HashMap *hashmap_build(Key *keys, Value *values, unsigned int count, unsigned int threads, HashFunc hashfunc, CmpFunc cmp) {
+    unsigned int parts = worker_count(threads, count);
+
+    HashMap *map = hashmap_new(partitioned_size(count, parts, HASHMAP_DEFAULT_LOAD), hashfunc, cmp);
+    if (!map) return NULL;
+    if (count == 0) return map;
+
+    BuildTask *tasks = calloc(parts, sizeof(BuildTask));
+    unsigned int *offsets = calloc((size_t) parts * parts, sizeof(unsigned int));
+    uint64_t *hashes = malloc((size_t) count * sizeof(uint64_t));
+    BuildSlot *slots = malloc((size_t) count * sizeof(BuildSlot));
+
+    if (!tasks || !offsets || !hashes || !slots) {
+        free(tasks);
+        free(offsets);
+        free(hashes);
+        free(slots);
+        hashmap_free(map);
+        return NULL;
+    }
+
+    for (unsigned int t = 0; t < parts; t++) {
+        tasks[t].map = map;
+        tasks[t].keys = keys;
+        tasks[t].values = values;
+        tasks[t].hashes = hashes;
+        tasks[t].slots = slots;
+        tasks[t].parts = parts;
+        tasks[t].from = (unsigned int) ((uint64_t) count * t / parts);
+        tasks[t].to = (unsigned int) ((uint64_t) count * (t + 1) / parts);
+        tasks[t].offsets = &offsets[(size_t) t * parts];
+    }
+
+    run_tasks(hash_chunk, tasks, sizeof(BuildTask), parts);
+
+    // Turn each thread's partition counts into where its pairs start.
+    unsigned int next = 0;
+    for (unsigned int p = 0; p < parts; p++) {
+        tasks[p].slot_from = next;
+        for (unsigned int t = 0; t < parts; t++) {
+            unsigned int n = tasks[t].offsets[p];
+            tasks[t].offsets[p] = next;
+            next += n;
+        }
+        tasks[p].slot_to = next;
+    }
+
+    run_tasks(scatter_chunk, tasks, sizeof(BuildTask), parts);
+    free(hashes);
+
+    run_tasks(link_partition, tasks, sizeof(BuildTask), parts);
+    free(slots);
+    free(offsets);
+
+    int failed = FALSE;
+    for (unsigned int t = 0; t < parts; t++) {
+        failed |= tasks[t].failed;
+        map->item_count += tasks[t].linked;
+    }
+
+    for (unsigned int t = 0; t < parts; t++) {
+        if (failed) free_arena(&tasks[t].arena);
+        else adopt_memory(&tasks[t].arena, map);
+    }
+    free(tasks);
+
+    if (failed) {
+        hashmap_free(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+static Value aggregate_input(int aggregate, Value *values, unsigned int i) {
+    return aggregate == AGGREGATE_COUNT ? 1 : values[i];
+}
+
+/*
+ * Combines two partial aggregates. Counts are combined by adding them, so
+ * folding in one more input is combining with its aggregate_input.
+ */
+static Value aggregate_merge(int aggregate, Value a, Value b) {
+    switch (aggregate) {
+        case AGGREGATE_MIN: return b < a ? b : a;
+        case AGGREGATE_MAX: return b > a ? b : a;
+        default: return a + b;
+    }
+}
+
+/*
+ * Aggregates a thread's share of the input into a private Hash Map hashed
+ * with the result's seed, then sorts its items into one chain per
+ * partition for the merge.
+ */
+static void *aggregate_chunk(void *arg) {
+    GroupTask *task = arg;
+    HashMap *local = hashmap_new(0, task->map->hash, task->map->cmp);
+    if (!local) {
+        task->failed = TRUE;
+        return NULL;
+    }
+    local->seed = task->map->seed;
+    task->local = local;
+
+    for (unsigned int i = task->from; i < task->to; i++) {
+        maintain(local);
+
+        Value val = aggregate_input(task->aggregate, task->values, i);
+        uint64_t hash = local->hash(task->keys[i], local->seed);
+        HashItem *item = search(task->keys[i], hash, local);
+
+        if (item) item->value = aggregate_merge(task->aggregate, item->value, val);
+        else if (!link_item(task->keys[i], val, hash, local)) {
+            task->failed = TRUE;
+            return NULL;
+        }
+    }
+
+    finish_rehash(local);
+
+    for (unsigned int b = 0; b < local->size; b++) {
+        HashItem *item = local->buckets[b];
+        while (item) {
+            HashItem *next = item->next;
+            HashItem **chain = &task->chains[bucket_of(item->hash, task->parts)];
+            item->next = *chain;
+            *chain = item;
+            item = next;
+        }
+        local->buckets[b] = NULL;
+    }
+
+    return NULL;
+}
+
+/*
+ * Merges one partition of every thread's private results into the result's
+ * buckets. Items are moved rather than copied; those whose key is already
+ * present are folded into it and their memory freed to the arena.
+ */
+static void *merge_partition(void *arg) {
+    GroupTask *task = arg;
+    HashMap *map = task->map;
+
+    for (unsigned int t = 0; t < task->parts; t++) {
+        HashItem *item = task->all[t].chains[task->part];
+
+        while (item) {
+            HashItem *next = item->next;
+            HashItem **bucket = &map->buckets[bucket_of(item->hash, map->size)];
+
+            HashItem *found = *bucket;
+            while (found && (found->hash != item->hash || map->cmp(found->key, item->key) != 0)) found = found->next;
+
+            if (found) {
+                found->value = aggregate_merge(task->aggregate, found->value, item->value);
+                free_item(item, &task->arena);
+            }
+            else {
+                item->next = *bucket;
+                *bucket = item;
+                task->linked++;
+            }
+
+            item = next;
+        }
+    }
+
+    return NULL;
+}
+
+HashMap *hashmap_group_by(Key *keys, Value *values, unsigned int count, int aggregate, unsigned int threads, HashFunc hashfunc, CmpFunc cmp) {
+    unsigned int parts = worker_count(threads, count);
+
+    HashMap *map = hashmap_new(0, hashfunc, cmp);
+    if (!map) return NULL;
+    if (count == 0) return map;
+
+    GroupTask *tasks = calloc(parts, sizeof(GroupTask));
+    HashItem **chains = calloc((size_t) parts * parts, sizeof(HashItem*));
+
+    if (!tasks || !chains) {
+        free(tasks);
+        free(chains);
+        hashmap_free(map);
+        return NULL;
+    }
+
+    for (unsigned int t = 0; t < parts; t++) {
+        tasks[t].map = map;
+        tasks[t].keys = keys;
+        tasks[t].values = values;
+        tasks[t].aggregate = aggregate;
+        tasks[t].parts = parts;
+        tasks[t].from = (unsigned int) ((uint64_t) count * t / parts);
+        tasks[t].to = (unsigned int) ((uint64_t) count * (t + 1) / parts);
+        tasks[t].chains = &chains[(size_t) t * parts];
+        tasks[t].part = t;
+        tasks[t].all = tasks;
+    }
+
+    run_tasks(aggregate_chunk, tasks, sizeof(GroupTask), parts);
+
+    int failed = FALSE;
+    unsigned int groups = 0;
+    for (unsigned int t = 0; t < parts; t++) {
+        failed |= tasks[t].failed;
+        if (tasks[t].local) groups += tasks[t].local->item_count;
+    }
+
+    if (!failed) failed = !resize_buckets(partitioned_size(groups, parts, map->max_load), map);
+    if (!failed) run_tasks(merge_partition, tasks, sizeof(GroupTask), parts);
+
+    for (unsigned int t = 0; t < parts; t++) {
+        if (!failed) {
+            map->item_count += tasks[t].linked;
+            adopt_memory(tasks[t].local, map);
+            adopt_memory(&tasks[t].arena, map);
+        }
+        if (tasks[t].local) hashmap_free(tasks[t].local);
+    }
+    free(chains);
+    free(tasks);
+
+    if (failed) {
+        hashmap_free(map);
+        return NULL;
+    }
+
+    return map;
+}
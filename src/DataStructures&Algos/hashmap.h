@@ -18,6 +18,8 @@
 #define SUCCESS 1
 #define FAILURE 0
 
+#include "hash.h"
+
 #ifndef Key
 #define Key char*
 #endif
@@ -26,14 +28,144 @@
 #define Value double
 #endif
 
+// Define HASHMAP_OWNED_KEYS before the include to have the Hash Map copy
+// string keys on insert, so callers need not keep them alive. Requires Key
+// to be char*. Short keys are stored inside the entry itself.
+#ifdef HASHMAP_OWNED_KEYS
+#ifndef HASHMAP_INLINE_KEY
+#define HASHMAP_INLINE_KEY 24
+#endif
+
+/** The size of each block that keys too long to store inline are copied into. */
+#define HASHMAP_KEY_BLOCK 65536
+#endif
+
+// Define HASHMAP_COUNTERS before the include to have lookups counted for
+// hashmap_stats. Only one lookup in every HASHMAP_SAMPLE_RATE, on average,
+// is recorded, so the cost stays close to nothing.
+#ifdef HASHMAP_COUNTERS
+#ifndef HASHMAP_SAMPLE_RATE
+#define HASHMAP_SAMPLE_RATE 64
+#endif
+#endif
+
+/** The number of buckets used when a Hash Map is created with size 0. */
+#define HASHMAP_DEFAULT_SIZE 16
+
+/** The default ratio of items to buckets above which a Hash Map grows. */
+#define HASHMAP_DEFAULT_LOAD 1.0f
+
+/** The number of HashItems carved from each slab allocation. */
+#define HASHMAP_SLAB_ITEMS 256
+
+/** The number of keys a batched lookup hashes and prefetches ahead of resolving them. */
+#define HASHMAP_BATCH_GROUP 32
+
+/** The number of non-empty buckets moved to the new table per operation while rehashing. */
+#define HASHMAP_REHASH_STEP 4
+
+/** The number of chain lengths hashmap_stats tells apart, longer chains share the last bin. */
+#define HASHMAP_STATS_BINS 16
+
+/** The most threads a parallel build or group-by runs on. */
+#define HASHMAP_MAX_THREADS 256
+
+/** The fewest input pairs worth handing to each thread of a parallel build or group-by. */
+#define HASHMAP_PARALLEL_GRAIN 16384
+
+/** Aggregates for hashmap_group_by: the sum, number, minimum or maximum of each key's values. */
+#define AGGREGATE_SUM 0
+#define AGGREGATE_COUNT 1
+#define AGGREGATE_MIN 2
+#define AGGREGATE_MAX 3
+
 
 typedef struct hashItem {
     Key key;
     Value value;
+    /** The full hash of key, compared before calling the CmpFunc */
+    uint64_t hash;
     struct hashItem *next;
+#ifdef HASHMAP_OWNED_KEYS
+    /** Holds keys shorter than HASHMAP_INLINE_KEY, in which case key points here */
+    char key_inline[HASHMAP_INLINE_KEY];
+#endif
 } HashItem;
 
-typedef int (*HashFunc)(Key key, int length);
+/**
+ * @brief A block of HashItems allocated at once, linked to the Hash Map's other slabs.
+ */
+typedef struct hashSlab {
+    struct hashSlab *next;
+    HashItem items[HASHMAP_SLAB_ITEMS];
+} HashSlab;
+
+#ifdef HASHMAP_OWNED_KEYS
+/**
+ * @brief A block of copied key strings, linked to the Hash Map's other key blocks.
+ */
+typedef struct hashKeyBlock {
+    struct hashKeyBlock *next;
+    char data[];
+} HashKeyBlock;
+#endif
+
+#ifdef HASHMAP_COUNTERS
+/**
+ * @brief Sampled operation counts kept by a Hash Map built with HASHMAP_COUNTERS.
+ */
+typedef struct hashMapCounters {
+    /** The number of lookups left until the next sampled one */
+    unsigned int countdown;
+    /** The state of the generator drawing the gaps between samples */
+    uint64_t rng;
+    /** The number of sampled lookups */
+    uint64_t lookups;
+    /** The number of sampled lookups that found nothing */
+    uint64_t misses;
+    /** The number of CmpFunc calls made by sampled lookups */
+    uint64_t cmp_calls;
+    /** Set while the current lookup is being sampled */
+    int sampling;
+} HashMapCounters;
+#endif
+
+/**
+ * @brief A snapshot of a Hash Map's shape, filled in by hashmap_stats.
+ */
+typedef struct hashMapStats {
+    /** The number of buckets holding each chain length, the last bin counting all longer chains */
+    unsigned int histogram[HASHMAP_STATS_BINS];
+    /** The length of the longest chain */
+    unsigned int max_chain;
+    /** The number of buckets, counting those of a table still being rehashed */
+    unsigned int bucket_count;
+    /** The number of key-value pairs */
+    unsigned int item_count;
+    /** The fraction of buckets that are empty */
+    double empty_ratio;
+    /** The number of items per bucket */
+    double load_factor;
+    /** The average number of items visited by a successful lookup */
+    double average_probe;
+    /** An estimate of the bytes held by the Hash Map and its filter, excluding unowned keys */
+    size_t memory;
+#ifdef HASHMAP_COUNTERS
+    /** The estimated number of lookups, scaled up from the sampled ones */
+    uint64_t lookups;
+    /** The estimated number of lookups that found nothing */
+    uint64_t misses;
+    /** The estimated number of CmpFunc calls made by lookups */
+    uint64_t cmp_calls;
+#endif
+} HashMapStats;
+
+struct bloomFilter;
+
+/**
+ * @brief Hashes a key to 64 bits. The seed is supplied by the Hash Map.
+ */
+typedef uint64_t (*HashFunc)(Key key, uint64_t seed);
 
 typedef int (*CmpFunc)(Key a, Key b);
 
@@ -44,42 +176,179 @@ typedef struct hashMap {
     unsigned int item_count;
     /** The Hash Map's buckets */
     HashItem **buckets;
+    /** The buckets being drained by an incremental rehash, NULL when not rehashing */
+    HashItem **old_buckets;
+    /** The number of buckets in old_buckets */
+    unsigned int old_size;
+    /** The next bucket of old_buckets to be moved */
+    unsigned int rehash_index;
+    /** The ratio of items to buckets above which the Hash Map grows */
+    float max_load;
+    /** The slabs HashItems are carved from */
+    HashSlab *slabs;
+    /** The number of HashItems not yet carved from the newest slab */
+    unsigned int slab_left;
+    /** HashItems that were removed and can be reused, linked through next */
+    HashItem *free_items;
+#ifdef HASHMAP_OWNED_KEYS
+    /** The blocks long keys are copied into */
+    HashKeyBlock *key_blocks;
+    /** The next free byte of the newest key block */
+    char *key_next;
+    /** The number of free bytes left in the newest key block */
+    size_t key_left;
+#endif
     /** A function to hash items into the Hash Map */
     HashFunc hash;
     /** A function to compare keys in the Hash Map */
     CmpFunc cmp;
+    /** The seed passed to hash, random per Hash Map */
+    uint64_t seed;
+    /** A Bloom filter of the keys' hashes, checked before the buckets, NULL when detached */
+    struct bloomFilter *filter;
+    /** The bits per key the filter is built with */
+    double filter_bits;
+    /** The number of keys removed since the filter was built, which it still reports */
+    unsigned int filter_stale;
+#ifdef HASHMAP_COUNTERS
+    HashMapCounters counters;
+#endif
 } HashMap;
 
 /**
  * @brief A default function for hashing chars.
 */
-int default_char_hash(char key, int length);
+uint64_t default_char_hash(char key, uint64_t seed);
 
 /**
  * @brief A default function for hashing strings.
  */
-int default_string_hash(char *key, int length);
+uint64_t default_string_hash(char *key, uint64_t seed);
 
 /**
  * @brief A default function for hashing ints.
  */
-int default_int_hash(int key, int length);
+uint64_t default_int_hash(int key, uint64_t seed);
 
 /**
  * @brief A default function for hashing doubles.
  */
-int default_double_hash(double key, int length);
+uint64_t default_double_hash(double key, uint64_t seed);
 
 /**
  * @brief Allocates a new Hash Map for use.
  * 
- * @param size The number of buckets to put in the Hash Map.
+ * The Hash Map grows once its load factor is crossed. Growing is
+ * incremental: each insert and lookup moves a few buckets to the new
+ * table, so no single call pays for a full rehash.
+ *
+ * @param size The initial number of buckets to put in the Hash Map.
  * @param hashfunc The hashing function to use when inserting.
+ * @param cmp The function used to compare keys.
  * 
  * @returns *HashMap
  */
 HashMap *hashmap_new(unsigned int size, HashFunc hashfunc, CmpFunc cmp);
 
+/**
+ * @brief Builds a Hash Map from arrays of keys and values on several threads.
+ *
+ * The pairs are hashed and radix-partitioned by the high bits of their
+ * hashes, one partition per thread. Each partition owns a contiguous range
+ * of buckets, so the threads link their items without any locking. The
+ * result is the same as inserting the pairs in order, duplicates included.
+ *
+ * @param keys The keys to insert.
+ * @param values The values, values[i] being associated with keys[i].
+ * @param count The number of pairs.
+ * @param threads The number of threads to use, 0 for one per online CPU.
+ * @param hashfunc The hashing function to use when inserting.
+ * @param cmp The function used to compare keys.
+ *
+ * @returns *HashMap, NULL if memory ran out.
+ */
+HashMap *hashmap_build(Key *keys, Value *values, unsigned int count, unsigned int threads, HashFunc hashfunc, CmpFunc cmp);
+
+/**
+ * @brief Aggregates the values of each distinct key into a new Hash Map on several threads.
+ *
+ * Each thread first aggregates its share of the input into a private Hash
+ * Map, so a key repeated within a share costs one lookup and no further
+ * memory. The private results are then partitioned by hash and merged, one
+ * partition per thread. Value must be an arithmetic type.
+ *
+ * The result is sized for the sum of the private maps' key counts, so keys
+ * seen by many threads leave it with spare buckets.
+ *
+ * @param keys The keys to group by.
+ * @param values The values to aggregate, may be NULL with AGGREGATE_COUNT.
+ * @param count The number of pairs.
+ * @param aggregate AGGREGATE_SUM, AGGREGATE_COUNT, AGGREGATE_MIN or AGGREGATE_MAX.
+ * @param threads The number of threads to use, 0 for one per online CPU.
+ * @param hashfunc The hashing function to use when inserting.
+ * @param cmp The function used to compare keys.
+ *
+ * @returns *HashMap mapping each distinct key to its aggregate, NULL if memory ran out.
+ */
+HashMap *hashmap_group_by(Key *keys, Value *values, unsigned int count, int aggregate, unsigned int threads, HashFunc hashfunc, CmpFunc cmp);
+
+/**
+ * @brief Sets the load factor above which a Hash Map doubles its buckets.
+ *
+ * @param load The maximum ratio of items to buckets, must be positive.
+ * @param map The Hash Map to configure.
+ *
+ * @returns 1 if the load factor was set, 0 otherwise.
+ */
+int hashmap_set_load_factor(float load, HashMap *map);
+
+/**
+ * @brief Presizes a Hash Map so that it can hold a number of items without growing.
+ *
+ * Any incremental rehash in progress is completed first.
+ *
+ * @param count The number of items to make room for.
+ * @param map The Hash Map to presize.
+ *
+ * @returns 1 if the Hash Map has room for count items, 0 otherwise.
+ */
+int hashmap_reserve(unsigned int count, HashMap *map);
+
+/**
+ * @brief Attaches a Bloom filter that lets lookups of absent keys skip the buckets.
+ *
+ * The filter is fed the hashes the Hash Map already computes, so a lookup
+ * costs no extra hashing. It is rebuilt as the Hash Map grows and once
+ * enough removed keys linger in it; these rebuilds are amortised over the
+ * inserts and removals that cause them. Lookups that find their key pay
+ * for one extra cache line, so a filter only helps when most lookups miss.
+ *
+ * @param bits_per_key The filter's size per key; bloom_bits_per_key converts from a false-positive rate.
+ * @param map The Hash Map to attach to. Any filter already attached is replaced.
+ *
+ * @returns 1 if the filter was attached, 0 otherwise.
+ */
+int hashmap_attach_filter(double bits_per_key, HashMap *map);
+
+/**
+ * @brief Detaches and frees a Hash Map's Bloom filter, if it has one.
+ *
+ * @param map The Hash Map to detach from.
+ */
+void hashmap_detach_filter(HashMap *map);
+
+/**
+ * @brief Measures how evenly a Hash Map's keys are spread over its buckets.
+ *
+ * Every bucket is visited, so this costs time linear in the Hash Map's
+ * size. Long chains and a high empty ratio at a moderate load factor point
+ * to a HashFunc that distributes the keys poorly.
+ *
+ * @param map The Hash Map to measure.
+ * @param out Receives the statistics.
+ */
+void hashmap_stats(HashMap *map, HashMapStats *out);
+
 /**
  * @brief Destroys a Hash Map and frees the memory back.
  * 
@@ -92,7 +361,8 @@ void hashmap_free(HashMap *map);
  * 
  * @param key The key to insert.
  * @param val The value to be associated with the key.
- * 
+ * @param map The Hash Map to insert into.
+ *
  * @returns 1 if the insertion was successful, 0 otherwise.
 */
 int insert(Key key, Value val, HashMap *map);
@@ -138,6 +408,33 @@ int remove_all(Key key, HashMap *map);
  */
 Value *get(Key key, HashMap *map);
 
+/**
+ * @brief Gets the associated values of many keys in a Hash Map.
+ *
+ * Keys are hashed and their buckets prefetched in groups before any chain
+ * is walked, so the memory latency of the lookups overlaps.
+ *
+ * @param keys The keys to look for.
+ * @param count The number of keys.
+ * @param out Receives, for each key, a pointer to its value or NULL.
+ * @param map The Hash Map to look through.
+ *
+ * @returns The number of keys that were found.
+ */
+unsigned int hashmap_get_batch(Key *keys, unsigned int count, Value **out, HashMap *map);
+
+/**
+ * @brief Checks for many keys in a Hash Map.
+ *
+ * @param keys The keys to look for.
+ * @param count The number of keys.
+ * @param out Receives, for each key, 1 if it is in the Hash Map and 0 otherwise.
+ * @param map The Hash Map to look through.
+ *
+ * @returns The number of keys that were found.
+ */
+unsigned int hashmap_contains_batch(Key *keys, unsigned int count, int *out, HashMap *map);
+
 /**
  * @brief Sets a key's value in a Hash Map.
  *
@@ -0,0 +1,395 @@
+/**
+ * @file mapped_hashmap.c
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief On-disk Hash Map snapshots, served straight from a memory mapping.
+ *
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include "mapped_hashmap.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define BYTE_ORDER_MARK 0x01020304u
+
+/* The payload is checksummed in blocks of this many bytes, chained by seed. */
+#define CHECKSUM_BLOCK 65536
+
+#define HEADER_SEED 0x5eed5eed5eed5eedULL
+
+/* From <stdio.h>, which cannot be included beside hashmap.h's remove. */
+int rename(const char *old_path, const char *new_path);
+
+typedef struct snapshotWriter {
+    int fd;
+    int ok;
+    uint64_t offset;
+    uint64_t checksum;
+    size_t used;
+    unsigned char buffer[CHECKSUM_BLOCK];
+} SnapshotWriter;
+
+static unsigned int bucket_of(uint64_t hash, uint64_t size) {
+    return (unsigned int) (((hash >> 32) * size) >> 32);
+}
+
+static uint64_t align_up(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+static int write_all(int fd, const void *data, size_t length) {
+    const unsigned char *p = data;
+    while (length > 0) {
+        ssize_t written = write(fd, p, length);
+        if (written <= 0) return FAILURE;
+        p += written;
+        length -= (size_t) written;
+    }
+    return SUCCESS;
+}
+
+static void flush(SnapshotWriter *w) {
+    if (w->used == 0) return;
+
+    w->checksum = hash_bytes(w->buffer, w->used, w->checksum);
+    if (!write_all(w->fd, w->buffer, w->used)) w->ok = FALSE;
+    w->used = 0;
+}
+
+static void put(const void *data, size_t length, SnapshotWriter *w) {
+    const unsigned char *p = data;
+
+    while (length > 0) {
+        size_t n = CHECKSUM_BLOCK - w->used;
+        if (n > length) n = length;
+
+        if (p) {
+            memcpy(w->buffer + w->used, p, n);
+            p += n;
+        }
+        else {
+            memset(w->buffer + w->used, 0, n);
+        }
+
+        w->used += n;
+        w->offset += n;
+        length -= n;
+
+        if (w->used == CHECKSUM_BLOCK) flush(w);
+    }
+}
+
+static void pad_to(uint64_t offset, SnapshotWriter *w) {
+    put(NULL, offset - w->offset, w);
+}
+
+static uint64_t checksum_payload(const unsigned char *data, uint64_t length) {
+    uint64_t checksum = 0;
+    for (uint64_t i = 0; i < length; i += CHECKSUM_BLOCK) {
+        uint64_t n = length - i < CHECKSUM_BLOCK ? length - i : CHECKSUM_BLOCK;
+        checksum = hash_bytes(data + i, n, checksum);
+    }
+    return checksum;
+}
+
+static uint64_t checksum_header(SnapshotHeader header) {
+    header.header_checksum = 0;
+    return hash_bytes(&header, sizeof(SnapshotHeader), HEADER_SEED);
+}
+
+#ifdef KEY_IS_SCALAR
+
+static uint64_t key_size(Key key) {
+    (void) key;
+    return align_up(sizeof(Key), 8);
+}
+
+static void put_key(Key key, SnapshotWriter *w) {
+    put(&key, sizeof(Key), w);
+    put(NULL, key_size(key) - sizeof(Key), w);
+}
+
+static Key read_key(uint64_t offset, MappedHashMap *map) {
+    Key key;
+    memcpy(&key, map->base + offset, sizeof(Key));
+    return key;
+}
+
+#else
+
+static uint64_t key_size(Key key) {
+    return strlen(key) + 1;
+}
+
+static void put_key(Key key, SnapshotWriter *w) {
+    put(key, key_size(key), w);
+}
+
+static Key read_key(uint64_t offset, MappedHashMap *map) {
+    return (Key) (map->base + offset);
+}
+
+#endif
+
+/*
+ * Lists the Hash Map's items grouped by snapshot bucket. Within a bucket
+ * items keep the order get finds them in, so a mapped lookup returns the
+ * same value for duplicate keys.
+ */
+static HashItem **group_items(HashMap *map, uint64_t bucket_count, uint64_t *starts) {
+    HashItem **items = malloc(((size_t) map->item_count + 1) * sizeof(HashItem *));
+    HashItem **grouped = malloc(((size_t) map->item_count + 1) * sizeof(HashItem *));
+
+    if (!items || !grouped) {
+        free(items);
+        free(grouped);
+        return NULL;
+    }
+
+    unsigned int count = 0;
+    HashItem **tables[2] = { map->buckets, map->old_buckets };
+    unsigned int sizes[2] = { map->size, map->old_size };
+
+    for (int t = 0; t < 2; t++) {
+        if (!tables[t]) continue;
+        for (unsigned int i = 0; i < sizes[t]; i++) {
+            for (HashItem *item = tables[t][i]; item; item = item->next) items[count++] = item;
+        }
+    }
+
+    memset(starts, 0, (bucket_count + 1) * sizeof(uint64_t));
+    for (unsigned int i = 0; i < count; i++) starts[bucket_of(items[i]->hash, bucket_count) + 1]++;
+    for (uint64_t b = 0; b < bucket_count; b++) starts[b + 1] += starts[b];
+
+    for (unsigned int i = 0; i < count; i++) {
+        grouped[starts[bucket_of(items[i]->hash, bucket_count)]++] = items[i];
+    }
+
+    // Filling shifted every start to the next bucket's; shift them back.
+    for (uint64_t b = bucket_count; b > 0; b--) starts[b] = starts[b - 1];
+    starts[0] = 0;
+
+    free(items);
+    return grouped;
+}
+
+/*
+ * Names the file a save is written to before it replaces path: in the same
+ * directory, so the rename cannot cross file systems, and per process, so
+ * concurrent saves do not write into each other's file.
+ */
+static char *temp_path(const char *path) {
+    size_t length = strlen(path);
+    char *temp = malloc(length + 32);
+    if (!temp) return NULL;
+
+    char digits[24];
+    int count = 0;
+    unsigned long pid = (unsigned long) getpid();
+    do {
+        digits[count++] = (char) ('0' + pid % 10);
+        pid /= 10;
+    } while (pid > 0);
+
+    memcpy(temp, path, length);
+    memcpy(temp + length, ".tmp.", 5);
+    length += 5;
+    while (count > 0) temp[length++] = digits[--count];
+    temp[length] = '\0';
+    return temp;
+}
+
+/*
+ * Flushes the directory holding path, so a rename into it survives a crash.
+ */
+static int sync_directory(const char *path) {
+    const char *slash = strrchr(path, '/');
+    int fd;
+
+    if (!slash) {
+        fd = open(".", O_RDONLY);
+    }
+    else {
+        size_t length = slash == path ? 1 : (size_t) (slash - path);
+        char *dir = malloc(length + 1);
+        if (!dir) return FAILURE;
+
+        memcpy(dir, path, length);
+        dir[length] = '\0';
+        fd = open(dir, O_RDONLY);
+        free(dir);
+    }
+
+    if (fd < 0) return FAILURE;
+    int result = fsync(fd) == 0 ? SUCCESS : FAILURE;
+    if (close(fd) != 0) result = FAILURE;
+    return result;
+}
+
+int hashmap_save(HashMap *map, const char *path) {
+    uint64_t n = map->item_count;
+    uint64_t bucket_count = n > 0 ? n : 1;
+
+    uint64_t *starts = malloc((bucket_count + 1) * sizeof(uint64_t));
+    SnapshotWriter *w = malloc(sizeof(SnapshotWriter));
+    HashItem **items = starts ? group_items(map, bucket_count, starts) : NULL;
+    char *temp = temp_path(path);
+
+    if (!starts || !w || !items || !temp) {
+        free(starts);
+        free(w);
+        free(items);
+        free(temp);
+        return FAILURE;
+    }
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(SnapshotHeader));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.key_size = SNAPSHOT_KEY_SIZE;
+    header.value_size = sizeof(Value);
+    header.item_count = n;
+    header.bucket_count = bucket_count;
+    header.seed = map->seed;
+    header.buckets_offset = align_up(sizeof(SnapshotHeader), 8);
+    header.entries_offset = align_up(header.buckets_offset + (bucket_count + 1) * sizeof(uint64_t), _Alignof(SnapshotEntry));
+    header.keys_offset = header.entries_offset + n * sizeof(SnapshotEntry);
+
+    // Write a new file and rename it over path. Mappings of the old snapshot
+    // keep its inode, so they stay valid, and a failed save leaves it intact.
+    w->fd = open(temp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    w->ok = w->fd >= 0;
+    w->offset = header.buckets_offset;
+    w->checksum = 0;
+    w->used = 0;
+
+    if (w->ok && lseek(w->fd, (off_t) header.buckets_offset, SEEK_SET) < 0) w->ok = FALSE;
+
+    if (w->ok) {
+        put(starts, (bucket_count + 1) * sizeof(uint64_t), w);
+        pad_to(header.entries_offset, w);
+
+        uint64_t key_offset = header.keys_offset;
+        for (uint64_t i = 0; i < n; i++) {
+            SnapshotEntry entry;
+            memset(&entry, 0, sizeof(SnapshotEntry));
+            entry.hash = items[i]->hash;
+            entry.key = key_offset;
+            entry.value = items[i]->value;
+            put(&entry, sizeof(SnapshotEntry), w);
+            key_offset += key_size(items[i]->key);
+        }
+
+        for (uint64_t i = 0; i < n; i++) put_key(items[i]->key, w);
+
+        flush(w);
+
+        header.file_size = w->offset;
+        header.payload_checksum = w->checksum;
+        header.header_checksum = checksum_header(header);
+
+        // The header goes in last, so a partially written file never validates.
+        if (w->ok && pwrite(w->fd, &header, sizeof(SnapshotHeader), 0) != sizeof(SnapshotHeader)) w->ok = FALSE;
+        if (w->ok && fsync(w->fd) != 0) w->ok = FALSE;
+    }
+
+    int result = w->ok;
+    if (w->fd >= 0 && close(w->fd) != 0) result = FAILURE;
+
+    if (result && rename(temp, path) == 0) {
+        result = sync_directory(path);
+    }
+    else {
+        if (w->fd >= 0) unlink(temp);
+        result = FAILURE;
+    }
+
+    free(starts);
+    free(items);
+    free(temp);
+    free(w);
+
+    return result;
+}
+
+static int valid_header(const SnapshotHeader *header, size_t length) {
+    if (length < sizeof(SnapshotHeader)) return FALSE;
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) return FALSE;
+    if (header->version != SNAPSHOT_VERSION) return FALSE;
+    if (header->byte_order != BYTE_ORDER_MARK) return FALSE;
+    if (header->key_size != SNAPSHOT_KEY_SIZE || header->value_size != sizeof(Value)) return FALSE;
+    if (header->header_checksum != checksum_header(*header)) return FALSE;
+    if (header->file_size != length || header->bucket_count == 0) return FALSE;
+    if (header->buckets_offset + (header->bucket_count + 1) * sizeof(uint64_t) > header->entries_offset) return FALSE;
+    if (header->entries_offset + header->item_count * sizeof(SnapshotEntry) != header->keys_offset) return FALSE;
+    if (header->keys_offset > length) return FALSE;
+    return TRUE;
+}
+
+MappedHashMap *hashmap_open_mmap(const char *path, HashFunc hashfunc, CmpFunc cmp) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(SnapshotHeader)) {
+        close(fd);
+        return NULL;
+    }
+
+    size_t length = (size_t) st.st_size;
+    void *base = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    MappedHashMap *map = malloc(sizeof(MappedHashMap));
+    if (!map || !valid_header(base, length)) {
+        free(map);
+        munmap(base, length);
+        return NULL;
+    }
+
+    map->base = base;
+    map->length = length;
+    map->header = base;
+    map->buckets = (const uint64_t *) (map->base + map->header->buckets_offset);
+    map->entries = (const SnapshotEntry *) (map->base + map->header->entries_offset);
+    map->hash = hashfunc;
+    map->cmp = cmp;
+
+    return map;
+}
+
+void mapped_hashmap_close(MappedHashMap *map) {
+    munmap((void *) map->base, map->length);
+    free(map);
+}
+
+int mapped_hashmap_verify(MappedHashMap *map) {
+    uint64_t offset = map->header->buckets_offset;
+    uint64_t checksum = checksum_payload(map->base + offset, map->length - offset);
+    return checksum == map->header->payload_checksum ? TRUE : FALSE;
+}
+
+const Value *mapped_get(Key key, MappedHashMap *map) {
+    uint64_t hash = map->hash(key, map->header->seed);
+    unsigned int b = bucket_of(hash, map->header->bucket_count);
+
+    for (uint64_t i = map->buckets[b]; i < map->buckets[b + 1]; i++) {
+        const SnapshotEntry *entry = &map->entries[i];
+        if (entry->hash == hash && map->cmp(key, read_key(entry->key, map)) == 0) return &(entry->value);
+    }
+
+    return NULL;
+}
+
+int mapped_contains(Key key, MappedHashMap *map) {
+    return mapped_get(key, map) ? TRUE : FALSE;
+}
@@ -0,0 +1,160 @@
+/**
+ * @file mapped_hashmap.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief On-disk Hash Map snapshots, served straight from a memory mapping.
+ *
+ * hashmap_save writes a Hash Map as a position-independent image: a
+ * header, a bucket index, fixed-size entries and a key area, all linked by
+ * file offsets. hashmap_open_mmap maps that file read-only and answers
+ * lookups from it directly, so opening costs the same at any size and the
+ * pages are shared by every process mapping the same file.
+ *
+ * The image is versioned, and both the header and the payload carry
+ * checksums. Values are copied byte for byte, so Value must not contain
+ * pointers.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_MAPPED_HASHMAP_H
+#define WESTLEY_MAPPED_HASHMAP_H
+
+#include "hashmap.h"
+#include <stddef.h>
+
+// Keys are stored as NUL-terminated strings by default. Define KEY_IS_SCALAR
+// before the include when Key is a plain value type such as int or double.
+#ifdef KEY_IS_SCALAR
+#define SNAPSHOT_KEY_SIZE sizeof(Key)
+#else
+#define SNAPSHOT_KEY_SIZE 0
+#endif
+
+#define SNAPSHOT_MAGIC "WHMSNAP"
+#define SNAPSHOT_VERSION 1
+
+/**
+ * @brief The header at the start of a snapshot file.
+ */
+typedef struct snapshotHeader {
+    char magic[8];
+    uint32_t version;
+    /** 0x01020304 as written, to reject files from hosts of another byte order */
+    uint32_t byte_order;
+    /** 0 for string keys, otherwise the size of a scalar Key */
+    uint32_t key_size;
+    uint32_t value_size;
+    uint64_t item_count;
+    uint64_t bucket_count;
+    /** The seed the stored hashes were computed with */
+    uint64_t seed;
+    /** File offset of bucket_count + 1 entry indices delimiting each bucket */
+    uint64_t buckets_offset;
+    /** File offset of the SnapshotEntry array */
+    uint64_t entries_offset;
+    /** File offset of the key area */
+    uint64_t keys_offset;
+    uint64_t file_size;
+    /** Checksum of everything after the header */
+    uint64_t payload_checksum;
+    /** Checksum of the header, computed with this field set to 0 */
+    uint64_t header_checksum;
+} SnapshotHeader;
+
+/**
+ * @brief A key-value entry of a snapshot file.
+ */
+typedef struct snapshotEntry {
+    uint64_t hash;
+    /** File offset of the entry's key in the key area */
+    uint64_t key;
+    Value value;
+} SnapshotEntry;
+
+/**
+ * @brief Definition of a @ref Mapped Hash Map.
+ */
+typedef struct mappedHashMap {
+    /** The start of the mapping */
+    const unsigned char *base;
+    /** The length of the mapping */
+    size_t length;
+    const SnapshotHeader *header;
+    const uint64_t *buckets;
+    const SnapshotEntry *entries;
+    /** A function to hash keys, which must be the one the snapshot was saved with */
+    HashFunc hash;
+    /** A function to compare keys */
+    CmpFunc cmp;
+} MappedHashMap;
+
+/**
+ * @brief Writes a Hash Map to a snapshot file.
+ *
+ * The snapshot is written to a temporary file beside path, which then
+ * replaces path by rename. Processes that have the old snapshot mapped
+ * keep reading it, and a failed save leaves it in place.
+ *
+ * @param map The Hash Map to save.
+ * @param path The file to write.
+ *
+ * @returns 1 if the snapshot was written, 0 otherwise.
+ */
+int hashmap_save(HashMap *map, const char *path);
+
+/**
+ * @brief Maps a snapshot file for lookups.
+ *
+ * Only the header is checked, so opening takes the same time at any size.
+ * Use mapped_hashmap_verify to check the whole payload.
+ *
+ * @param path The snapshot file.
+ * @param hashfunc The hashing function the snapshot was saved with.
+ * @param cmp The function used to compare keys.
+ *
+ * @returns *MappedHashMap, NULL if the file could not be mapped or is not a valid snapshot.
+ */
+MappedHashMap *hashmap_open_mmap(const char *path, HashFunc hashfunc, CmpFunc cmp);
+
+/**
+ * @brief Unmaps a snapshot and frees the memory back.
+ *
+ * @param map The Mapped Hash Map to close.
+ */
+void mapped_hashmap_close(MappedHashMap *map);
+
+/**
+ * @brief Checks a mapped snapshot's payload against its checksum.
+ *
+ * This reads the whole file.
+ *
+ * @param map The Mapped Hash Map to verify.
+ *
+ * @returns 1 if the payload is intact, 0 otherwise.
+ */
+int mapped_hashmap_verify(MappedHashMap *map);
+
+/**
+ * @brief Gets the associated value to a key in a Mapped Hash Map.
+ *
+ * @param key The key to look for.
+ * @param map The Mapped Hash Map to look through.
+ *
+ * @returns A read-only pointer into the mapping, NULL if the value does not exist.
+ */
+const Value *mapped_get(Key key, MappedHashMap *map);
+
+/**
+ * @brief Checks for a given key in a Mapped Hash Map.
+ *
+ * @param key The key to look for.
+ * @param map The Mapped Hash Map to look through.
+ *
+ * @returns 1 if the key is in the Mapped Hash Map, 0 otherwise.
+ */
+int mapped_contains(Key key, MappedHashMap *map);
+
+#endif
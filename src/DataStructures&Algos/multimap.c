@@ -0,0 +1,274 @@
+/**
+ * @file multimap.c
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief A Hash Map from each key to a contiguous run of values.
+ *
+ */
+
+#include "multimap.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+static unsigned int bucket_of(uint64_t hash, unsigned int size) {
+    return (unsigned int) (((hash >> 32) * size) >> 32);
+}
+
+static MultiEntry *alloc_entry(MultiMap *map) {
+    if (map->free_entries) {
+        MultiEntry *entry = map->free_entries;
+        map->free_entries = entry->next;
+        return entry;
+    }
+
+    if (map->slab_left == 0) {
+        MultiSlab *slab = malloc(sizeof(MultiSlab));
+        if (!slab) return NULL;
+
+        slab->next = map->slabs;
+        map->slabs = slab;
+        map->slab_left = MULTIMAP_SLAB_ENTRIES;
+    }
+
+    return &map->slabs->entries[MULTIMAP_SLAB_ENTRIES - map->slab_left--];
+}
+
+static void free_values(MultiEntry *entry) {
+    if (entry->values != entry->inline_values) free(entry->values);
+}
+
+/*
+ * Frees the values of every entry still linked into a bucket, then the
+ * slabs. Removed entries gave their values back when they were unlinked.
+ */
+static void free_entries(MultiMap *map) {
+    for (unsigned int i = 0; i < map->size; i++) {
+        for (MultiEntry *entry = map->buckets[i]; entry; entry = entry->next) free_values(entry);
+    }
+
+    MultiSlab *current = map->slabs;
+    MultiSlab *prev;
+    while (current)
+    {
+        prev = current;
+        current = current->next;
+        free(prev);
+    }
+    map->slabs = NULL;
+    map->slab_left = 0;
+    map->free_entries = NULL;
+}
+
+static MultiEntry **find_link(Key key, uint64_t hash, MultiMap *map) {
+    MultiEntry **link = &map->buckets[bucket_of(hash, map->size)];
+    while (*link) {
+        if ((*link)->hash == hash && map->cmp(key, (*link)->key) == 0) return link;
+        link = &(*link)->next;
+    }
+    return NULL;
+}
+
+static MultiEntry *find_entry(Key key, MultiMap *map) {
+    MultiEntry **link = find_link(key, map->hash(key, map->seed), map);
+    return link ? *link : NULL;
+}
+
+/*
+ * Doubles the buckets once there are more keys than buckets. Failing to
+ * grow is not an error: the Multimap keeps working, only with longer chains.
+ */
+static void grow(MultiMap *map) {
+    if (map->key_count <= map->size || map->size >= UINT_MAX / 2) return;
+
+    unsigned int size = map->size * 2;
+    MultiEntry **buckets = calloc(size, sizeof(MultiEntry*));
+    if (!buckets) return;
+
+    for (unsigned int i = 0; i < map->size; i++) {
+        MultiEntry *entry = map->buckets[i];
+        while (entry) {
+            MultiEntry *next = entry->next;
+            unsigned int b = bucket_of(entry->hash, size);
+            entry->next = buckets[b];
+            buckets[b] = entry;
+            entry = next;
+        }
+    }
+
+    free(map->buckets);
+    map->buckets = buckets;
+    map->size = size;
+}
+
+/*
+ * Doubles the room for a key's values, moving them to the heap the first
+ * time they outgrow the entry.
+ */
+static int grow_values(MultiEntry *entry) {
+    if (entry->capacity > UINT_MAX / 2) return FAILURE;
+
+    unsigned int capacity = entry->capacity * 2;
+    Value *values;
+
+    if (entry->values == entry->inline_values) {
+        values = malloc(capacity * sizeof(Value));
+        if (!values) return FAILURE;
+        memcpy(values, entry->inline_values, entry->count * sizeof(Value));
+    }
+    else {
+        values = realloc(entry->values, capacity * sizeof(Value));
+        if (!values) return FAILURE;
+    }
+
+    entry->values = values;
+    entry->capacity = capacity;
+
+    return SUCCESS;
+}
+
+static unsigned int unlink_entry(MultiEntry **link, MultiMap *map) {
+    MultiEntry *entry = *link;
+    unsigned int removed = entry->count;
+
+    *link = entry->next;
+    free_values(entry);
+    entry->next = map->free_entries;
+    map->free_entries = entry;
+
+    map->key_count--;
+    map->value_count -= removed;
+
+    return removed;
+}
+
+MultiMap *multimap_new(unsigned int size, HashFunc hashfunc, CmpFunc cmp) {
+    if (size == 0) size = HASHMAP_DEFAULT_SIZE;
+
+    MultiMap *map = malloc(sizeof(MultiMap));
+    if (!map) return NULL;
+
+    map->buckets = calloc(size, sizeof(MultiEntry*));
+    if (!map->buckets) {
+        free(map);
+        return NULL;
+    }
+
+    map->size = size;
+    map->key_count = 0;
+    map->value_count = 0;
+    map->slabs = NULL;
+    map->slab_left = 0;
+    map->free_entries = NULL;
+    map->hash = hashfunc;
+    map->cmp = cmp;
+    map->seed = hash_random_seed();
+
+    return map;
+}
+
+void multimap_free(MultiMap *map) {
+    free_entries(map);
+    free(map->buckets);
+    free(map);
+}
+
+int multimap_insert(Key key, Value val, MultiMap *map) {
+    uint64_t hash = map->hash(key, map->seed);
+    MultiEntry **link = find_link(key, hash, map);
+    MultiEntry *entry;
+
+    if (link) {
+        entry = *link;
+        if (entry->count == entry->capacity && !grow_values(entry)) return FAILURE;
+    }
+    else {
+        entry = alloc_entry(map);
+        if (!entry) return FAILURE;
+
+        unsigned int b = bucket_of(hash, map->size);
+        entry->key = key;
+        entry->hash = hash;
+        entry->count = 0;
+        entry->capacity = MULTIMAP_INLINE_VALUES;
+        entry->values = entry->inline_values;
+        entry->next = map->buckets[b];
+        map->buckets[b] = entry;
+        map->key_count++;
+
+        grow(map);
+    }
+
+    entry->values[entry->count++] = val;
+    map->value_count++;
+
+    return SUCCESS;
+}
+
+ValueSpan multimap_get_all(Key key, MultiMap *map) {
+    ValueSpan span = { NULL, 0 };
+    MultiEntry *entry = find_entry(key, map);
+
+    if (entry) {
+        span.values = entry->values;
+        span.count = entry->count;
+    }
+
+    return span;
+}
+
+unsigned int multimap_count(Key key, MultiMap *map) {
+    MultiEntry *entry = find_entry(key, map);
+    return entry ? entry->count : 0;
+}
+
+int multimap_contains(Key key, MultiMap *map) {
+    return find_entry(key, map) ? TRUE : FALSE;
+}
+
+unsigned int multimap_remove_key(Key key, MultiMap *map) {
+    MultiEntry **link = find_link(key, map->hash(key, map->seed), map);
+    return link ? unlink_entry(link, map) : 0;
+}
+
+unsigned int multimap_remove_keys(Key *keys, unsigned int count, MultiMap *map) {
+    unsigned int removed = 0;
+
+    for (unsigned int i = 0; i < count; i++) removed += multimap_remove_key(keys[i], map);
+
+    return removed;
+}
+
+unsigned int multimap_remove_if(Key key, ValuePredicate pred, void *context, MultiMap *map) {
+    MultiEntry **link = find_link(key, map->hash(key, map->seed), map);
+    if (!link) return 0;
+
+    MultiEntry *entry = *link;
+    unsigned int kept = 0;
+
+    // Compact the survivors forward in one pass.
+    for (unsigned int i = 0; i < entry->count; i++) {
+        if (!pred(entry->values[i], context)) entry->values[kept++] = entry->values[i];
+    }
+
+    // Every value matched, and the entry still holds its old count.
+    if (kept == 0) return unlink_entry(link, map);
+
+    unsigned int removed = entry->count - kept;
+    entry->count = kept;
+    map->value_count -= removed;
+
+    return removed;
+}
+
+int multimap_empty(MultiMap *map) {
+    return map->key_count == 0 ? TRUE : FALSE;
+}
+
+void multimap_clear(MultiMap *map) {
+    free_entries(map);
+    memset(map->buckets, '\0', map->size * sizeof(MultiEntry*));
+    map->key_count = 0;
+    map->value_count = 0;
+}
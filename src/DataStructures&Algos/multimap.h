@@ -0,0 +1,206 @@
+/**
+ * @file multimap.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief A Hash Map from each key to a contiguous run of values.
+ *
+ * A Hash Map accepts the same key many times, but each value then lives in
+ * an item of its own, scattered along the chain. A Multimap stores each
+ * distinct key once, with its values side by side in a small vector: the
+ * first few sit inside the entry itself, and only longer runs move to the
+ * heap. Fetching every value of a key is one lookup returning one span.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_MULTIMAP_H
+#define WESTLEY_MULTIMAP_H
+
+#include "hashmap.h"
+
+/** The number of values stored inside an entry before they move to the heap. */
+#define MULTIMAP_INLINE_VALUES 4
+
+/** The number of MultiEntries carved from each slab allocation. */
+#define MULTIMAP_SLAB_ENTRIES 256
+
+/**
+ * @brief A key and all of its values.
+ */
+typedef struct multiEntry {
+    Key key;
+    uint64_t hash;
+    /** The number of values */
+    unsigned int count;
+    /** The number of values that fit before values must grow */
+    unsigned int capacity;
+    /** The values, pointing at inline_values until they outgrow it */
+    Value *values;
+    /** The next entry in the same bucket */
+    struct multiEntry *next;
+    Value inline_values[MULTIMAP_INLINE_VALUES];
+} MultiEntry;
+
+/**
+ * @brief A block of MultiEntries allocated at once, linked to the Multimap's other slabs.
+ */
+typedef struct multiSlab {
+    struct multiSlab *next;
+    MultiEntry entries[MULTIMAP_SLAB_ENTRIES];
+} MultiSlab;
+
+/**
+ * @brief A read-only view of a key's values.
+ */
+typedef struct valueSpan {
+    /** The first value, NULL when there are none */
+    Value *values;
+    /** The number of values */
+    unsigned int count;
+} ValueSpan;
+
+/**
+ * @brief Picks the values multimap_remove_if removes.
+ */
+typedef int (*ValuePredicate)(Value value, void *context);
+
+/**
+ * @brief Definition of a @ref Multimap.
+ */
+typedef struct multiMap {
+    /** The number of buckets */
+    unsigned int size;
+    /** The number of distinct keys */
+    unsigned int key_count;
+    /** The number of values, across all keys */
+    unsigned int value_count;
+    MultiEntry **buckets;
+    /** The slabs MultiEntries are carved from */
+    MultiSlab *slabs;
+    /** The number of MultiEntries not yet carved from the newest slab */
+    unsigned int slab_left;
+    /** MultiEntries that were removed and can be reused, linked through next */
+    MultiEntry *free_entries;
+    /** A function to hash keys */
+    HashFunc hash;
+    /** A function to compare keys */
+    CmpFunc cmp;
+    /** The seed passed to hash, random per Multimap */
+    uint64_t seed;
+} MultiMap;
+
+/**
+ * @brief Allocates a new Multimap for use.
+ *
+ * @param size The initial number of buckets, or 0 for the default.
+ * @param hashfunc The hashing function to use when inserting.
+ * @param cmp The function used to compare keys.
+ *
+ * @returns *MultiMap
+ */
+MultiMap *multimap_new(unsigned int size, HashFunc hashfunc, CmpFunc cmp);
+
+/**
+ * @brief Destroys a Multimap and frees the memory back.
+ *
+ * @param map The Multimap to free.
+ */
+void multimap_free(MultiMap *map);
+
+/**
+ * @brief Appends a value to a key's values, adding the key if it is new.
+ *
+ * @param key The key to insert under.
+ * @param val The value to append.
+ * @param map The Multimap to insert into.
+ *
+ * @returns 1 if the insertion was successful, 0 otherwise.
+ */
+int multimap_insert(Key key, Value val, MultiMap *map);
+
+/**
+ * @brief Gets every value of a key, in insertion order.
+ *
+ * @param key The key to look for.
+ * @param map The Multimap to look through.
+ *
+ * @returns The key's values, an empty span if the key is absent. The span
+ *          is invalidated by the next insert or removal under the key.
+ */
+ValueSpan multimap_get_all(Key key, MultiMap *map);
+
+/**
+ * @brief Counts the values of a key.
+ *
+ * @param key The key to look for.
+ * @param map The Multimap to look through.
+ *
+ * @returns The number of values, 0 if the key is absent.
+ */
+unsigned int multimap_count(Key key, MultiMap *map);
+
+/**
+ * @brief Checks for a given key in a Multimap.
+ *
+ * @param key The key to look for.
+ * @param map The Multimap to look through.
+ *
+ * @returns 1 if the key is in the Multimap, 0 otherwise.
+ */
+int multimap_contains(Key key, MultiMap *map);
+
+/**
+ * @brief Removes a key and all of its values at once.
+ *
+ * @param key The key to remove.
+ * @param map The Multimap to remove from.
+ *
+ * @returns The number of values that were removed.
+ */
+unsigned int multimap_remove_key(Key key, MultiMap *map);
+
+/**
+ * @brief Removes many keys, and all of their values.
+ *
+ * @param keys The keys to remove.
+ * @param count The number of keys.
+ * @param map The Multimap to remove from.
+ *
+ * @returns The number of values that were removed.
+ */
+unsigned int multimap_remove_keys(Key *keys, unsigned int count, MultiMap *map);
+
+/**
+ * @brief Removes the values of a key that match a predicate, in one pass.
+ *
+ * The remaining values keep their order. The key is removed along with
+ * its last value.
+ *
+ * @param key The key whose values to filter.
+ * @param pred Returns nonzero for each value to remove.
+ * @param context Passed through to pred.
+ * @param map The Multimap to remove from.
+ *
+ * @returns The number of values that were removed.
+ */
+unsigned int multimap_remove_if(Key key, ValuePredicate pred, void *context, MultiMap *map);
+
+/**
+ * @brief Checks if a Multimap is empty.
+ *
+ * @param map The Multimap to evaluate.
+ *
+ * @returns 1 if the Multimap is empty, 0 otherwise.
+ */
+int multimap_empty(MultiMap *map);
+
+/**
+ * @brief Removes all keys and values from a Multimap.
+ *
+ * @param map The Multimap to clear.
+ */
+void multimap_clear(MultiMap *map);
+
+#endif
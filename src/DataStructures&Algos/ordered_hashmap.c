@@ -0,0 +1,254 @@
+/**
+ * @file ordered_hashmap.c
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief A compact key-value Hash Map that remembers insertion order.
+ *
+ */
+
+#include "ordered_hashmap.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#define INDEX_EMPTY (-1)
+#define INDEX_DUMMY (-2)
+
+#define MIN_INDEX_SIZE 8
+
+/* The largest power of two an unsigned int index size can hold. */
+#define MAX_INDEX_SIZE (UINT_MAX / 2 + 1)
+
+/* At most 2/3 of the index slots are ever used, as in CPython's dict. */
+static unsigned int usable(unsigned int index_size) {
+    return index_size / 3 * 2;
+}
+
+static unsigned int width_for(unsigned int index_size) {
+    if (index_size <= 128) return 1;
+    if (index_size <= 32768) return 2;
+    return 4;
+}
+
+static long get_index(unsigned int i, OrderedHashMap *map) {
+    switch (map->index_width) {
+        case 1: return ((signed char *) map->indices)[i];
+        case 2: return ((short *) map->indices)[i];
+        default: return ((int *) map->indices)[i];
+    }
+}
+
+static void set_index(unsigned int i, long ix, OrderedHashMap *map) {
+    switch (map->index_width) {
+        case 1: ((signed char *) map->indices)[i] = (signed char) ix; break;
+        case 2: ((short *) map->indices)[i] = (short) ix; break;
+        default: ((int *) map->indices)[i] = (int) ix; break;
+    }
+}
+
+static uint64_t hash_of(Key key, OrderedHashMap *map) {
+    uint64_t hash = map->hash(key, map->seed);
+    return hash == ORDERED_DELETED ? hash - 1 : hash;
+}
+
+/*
+ * Probes the index table with CPython's perturbed sequence, which mixes in
+ * the high bits of the hash and visits every slot eventually.
+ */
+#define PROBE_NEXT(i, perturb, mask) \
+    ((perturb) >>= 5, (i) = (unsigned int) (((i) * 5 + (perturb) + 1) & (mask)))
+
+/*
+ * Finds the entry holding a key, returning its offset into entries and the
+ * index slot pointing at it, or -1 if the key is absent.
+ */
+static long lookup(Key key, uint64_t hash, unsigned int *slot, OrderedHashMap *map) {
+    unsigned int mask = map->index_size - 1;
+    unsigned int i = (unsigned int) hash & mask;
+    uint64_t perturb = hash;
+
+    for (;;) {
+        long ix = get_index(i, map);
+        if (ix == INDEX_EMPTY) return -1;
+
+        if (ix >= 0) {
+            OrderedEntry *entry = &map->entries[ix];
+            if (entry->hash == hash && map->cmp(key, entry->key) == 0) {
+                if (slot) *slot = i;
+                return ix;
+            }
+        }
+        PROBE_NEXT(i, perturb, mask);
+    }
+}
+
+static unsigned int find_empty_slot(uint64_t hash, OrderedHashMap *map) {
+    unsigned int mask = map->index_size - 1;
+    unsigned int i = (unsigned int) hash & mask;
+    uint64_t perturb = hash;
+
+    while (get_index(i, map) != INDEX_EMPTY) PROBE_NEXT(i, perturb, mask);
+
+    return i;
+}
+
+/*
+ * Rebuilds the map with room for twice its current items, dropping removed
+ * entries and picking the narrowest index width that fits. Fails if
+ * min_items is more than MAX_INDEX_SIZE can hold.
+ */
+static int rebuild(unsigned int min_items, OrderedHashMap *map) {
+    unsigned int index_size = MIN_INDEX_SIZE;
+    while (usable(index_size) < min_items) {
+        if (index_size == MAX_INDEX_SIZE) return FAILURE;
+        index_size *= 2;
+    }
+
+    unsigned int width = width_for(index_size);
+    void *indices = malloc((size_t) index_size * width);
+    if (!indices) return FAILURE;
+
+    OrderedEntry *entries = malloc(usable(index_size) * sizeof(OrderedEntry));
+    if (!entries) {
+        free(indices);
+        return FAILURE;
+    }
+
+    memset(indices, 0xFF, (size_t) index_size * width);
+
+    unsigned int used = 0;
+    for (unsigned int i = 0; i < map->entries_used; i++) {
+        if (map->entries[i].hash != ORDERED_DELETED) entries[used++] = map->entries[i];
+    }
+
+    free(map->indices);
+    free(map->entries);
+
+    map->indices = indices;
+    map->index_size = index_size;
+    map->index_width = width;
+    map->entries = entries;
+    map->entries_allocated = usable(index_size);
+    map->entries_used = used;
+
+    for (unsigned int i = 0; i < used; i++) {
+        set_index(find_empty_slot(entries[i].hash, map), i, map);
+    }
+
+    return SUCCESS;
+}
+
+static int append_entry(Key key, Value val, uint64_t hash, OrderedHashMap *map) {
+    if (map->entries_used == map->entries_allocated) {
+        unsigned int room = map->item_count < UINT_MAX / 2 ? 2 * map->item_count + 1 : UINT_MAX;
+        if (!rebuild(room, map)) return FAILURE;
+    }
+
+    unsigned int ix = map->entries_used++;
+    map->entries[ix].hash = hash;
+    map->entries[ix].key = key;
+    map->entries[ix].value = val;
+    set_index(find_empty_slot(hash, map), ix, map);
+    map->item_count++;
+
+    return SUCCESS;
+}
+
+OrderedHashMap *ordered_hashmap_new(unsigned int size, HashFunc hashfunc, CmpFunc cmp) {
+    OrderedHashMap *map = malloc(sizeof(OrderedHashMap));
+    if (!map) return NULL;
+
+    map->item_count = 0;
+    map->entries_used = 0;
+    map->entries = NULL;
+    map->indices = NULL;
+    map->hash = hashfunc;
+    map->cmp = cmp;
+    map->seed = hash_random_seed();
+
+    if (!rebuild(size, map)) {
+        free(map);
+        return NULL;
+    }
+
+    return map;
+}
+
+void ordered_hashmap_free(OrderedHashMap *map) {
+    free(map->entries);
+    free(map->indices);
+    free(map);
+}
+
+int ordered_insert(Key key, Value val, OrderedHashMap *map) {
+    uint64_t hash = hash_of(key, map);
+    long ix = lookup(key, hash, NULL, map);
+
+    if (ix != -1) {
+        map->entries[ix].value = val;
+        return SUCCESS;
+    }
+
+    return append_entry(key, val, hash, map);
+}
+
+int ordered_insert_if_absent(Key key, Value val, OrderedHashMap *map) {
+    uint64_t hash = hash_of(key, map);
+
+    if (lookup(key, hash, NULL, map) != -1) return FAILURE;
+
+    return append_entry(key, val, hash, map);
+}
+
+int ordered_remove(Key key, OrderedHashMap *map) {
+    unsigned int slot;
+    long ix = lookup(key, hash_of(key, map), &slot, map);
+    if (ix == -1) return FAILURE;
+
+    set_index(slot, INDEX_DUMMY, map);
+    map->entries[ix].hash = ORDERED_DELETED;
+    map->item_count--;
+
+    return SUCCESS;
+}
+
+Value *ordered_get(Key key, OrderedHashMap *map) {
+    long ix = lookup(key, hash_of(key, map), NULL, map);
+    return ix == -1 ? NULL : &(map->entries[ix].value);
+}
+
+int ordered_set(Key key, Value new_val, OrderedHashMap *map) {
+    Value *val = ordered_get(key, map);
+    if (!val) return FAILURE;
+
+    *val = new_val;
+    return SUCCESS;
+}
+
+int ordered_contains(Key key, OrderedHashMap *map) {
+    return ordered_get(key, map) ? TRUE : FALSE;
+}
+
+int ordered_empty(OrderedHashMap *map) {
+    return map->item_count == 0 ? TRUE : FALSE;
+}
+
+void ordered_clear(OrderedHashMap *map) {
+    memset(map->indices, 0xFF, (size_t) map->index_size * map->index_width);
+    map->entries_used = 0;
+    map->item_count = 0;
+}
+
+int ordered_next(unsigned int *pos, Key *key, Value *value, OrderedHashMap *map) {
+    while (*pos < map->entries_used) {
+        OrderedEntry *entry = &map->entries[(*pos)++];
+        if (entry->hash == ORDERED_DELETED) continue;
+
+        if (key) *key = entry->key;
+        if (value) *value = entry->value;
+        return TRUE;
+    }
+
+    return FALSE;
+}
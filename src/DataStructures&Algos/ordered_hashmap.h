@@ -0,0 +1,178 @@
+/**
+ * @file ordered_hashmap.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief A compact key-value Hash Map that remembers insertion order.
+ *
+ * Entries are stored densely, in insertion order, in a single array. The
+ * hash table itself only holds indices into that array, using 8, 16 or
+ * 32-bit slots depending on its size. Iterating is a linear scan over the
+ * entries, and the table costs a few bytes per entry on top of the
+ * entries themselves.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_ORDERED_HASHMAP_H
+#define WESTLEY_ORDERED_HASHMAP_H
+
+#include "hashmap.h"
+
+/**
+ * @brief A key-value entry of an @ref Ordered Hash Map.
+ */
+typedef struct orderedEntry {
+    /** The full hash of key, or ORDERED_DELETED once the entry is removed */
+    uint64_t hash;
+    Key key;
+    Value value;
+} OrderedEntry;
+
+/** The hash marking a removed entry. Live hashes never take this value. */
+#define ORDERED_DELETED UINT64_MAX
+
+/**
+ * @brief Definition of an @ref Ordered Hash Map.
+ */
+typedef struct orderedHashMap {
+    /** The number of key-value pairs in the Ordered Hash Map */
+    unsigned int item_count;
+    /** The number of entries used, including removed ones */
+    unsigned int entries_used;
+    /** The number of entries that fit before the table must be rebuilt */
+    unsigned int entries_allocated;
+    /** The entries, in insertion order */
+    OrderedEntry *entries;
+    /** The number of index slots (a power of two) */
+    unsigned int index_size;
+    /** The width of each index slot in bytes: 1, 2 or 4 */
+    unsigned int index_width;
+    /** The index slots, each empty, removed or an offset into entries */
+    void *indices;
+    /** A function to hash items into the Ordered Hash Map */
+    HashFunc hash;
+    /** A function to compare keys in the Ordered Hash Map */
+    CmpFunc cmp;
+    /** The seed passed to hash, random per Ordered Hash Map */
+    uint64_t seed;
+} OrderedHashMap;
+
+/**
+ * @brief Allocates a new Ordered Hash Map for use.
+ *
+ * @param size The number of items to make room for up front.
+ * @param hashfunc The hashing function to use when inserting.
+ * @param cmp The function used to compare keys.
+ *
+ * @returns *OrderedHashMap, NULL if size is more than any index can hold or memory ran out.
+ */
+OrderedHashMap *ordered_hashmap_new(unsigned int size, HashFunc hashfunc, CmpFunc cmp);
+
+/**
+ * @brief Destroys an Ordered Hash Map and frees the memory back.
+ *
+ * @param map The Ordered Hash Map to free.
+ */
+void ordered_hashmap_free(OrderedHashMap *map);
+
+/**
+ * @brief Inserts a key-value pair into an Ordered Hash Map.
+ *
+ * If the key is already present its value is replaced and it keeps its
+ * position in the order.
+ *
+ * @param key The key to insert.
+ * @param val The value to be associated with the key.
+ * @param map The Ordered Hash Map to insert into.
+ *
+ * @returns 1 if the insertion was successful, 0 otherwise.
+ */
+int ordered_insert(Key key, Value val, OrderedHashMap *map);
+
+/**
+ * @brief Inserts a key-value pair into an Ordered Hash Map if the key is not already present.
+ *
+ * @param key The key to insert.
+ * @param val The value to be associated with the key.
+ * @param map The Ordered Hash Map to insert into.
+ *
+ * @returns 1 if the insertion was successful, 0 otherwise.
+ */
+int ordered_insert_if_absent(Key key, Value val, OrderedHashMap *map);
+
+/**
+ * @brief Removes a key (and its associated value) from an Ordered Hash Map.
+ *
+ * @param key The key to remove.
+ * @param map The Ordered Hash Map to remove from.
+ *
+ * @returns 1 if the removal was successful, 0 otherwise.
+ */
+int ordered_remove(Key key, OrderedHashMap *map);
+
+/**
+ * @brief Gets the associated value to a key in an Ordered Hash Map.
+ *
+ * @param key The key to look for.
+ * @param map The Ordered Hash Map to look through.
+ *
+ * @returns A pointer to found value, NULL if the value does not exist.
+ *          The pointer is invalidated by the next insert.
+ */
+Value *ordered_get(Key key, OrderedHashMap *map);
+
+/**
+ * @brief Sets a key's value in an Ordered Hash Map.
+ *
+ * @param key The key to set.
+ * @param new_val The new value.
+ * @param map The Ordered Hash Map.
+ *
+ * @returns 1 if the value was successfully set, 0 otherwise.
+ */
+int ordered_set(Key key, Value new_val, OrderedHashMap *map);
+
+/**
+ * @brief Checks for a given key in an Ordered Hash Map.
+ *
+ * @param key The key to look for.
+ * @param map The Ordered Hash Map to look through.
+ *
+ * @returns 1 if the key is in the Ordered Hash Map, 0 otherwise.
+ */
+int ordered_contains(Key key, OrderedHashMap *map);
+
+/**
+ * @brief Checks if an Ordered Hash Map is empty.
+ *
+ * @param map The Ordered Hash Map to evaluate.
+ *
+ * @returns 1 if the Ordered Hash Map is empty, 0 otherwise.
+ */
+int ordered_empty(OrderedHashMap *map);
+
+/**
+ * @brief Removes all key-value pairs from an Ordered Hash Map.
+ *
+ * @param map The Ordered Hash Map to clear.
+ */
+void ordered_clear(OrderedHashMap *map);
+
+/**
+ * @brief Steps through an Ordered Hash Map in insertion order.
+ *
+ * Start with *pos set to 0 and call repeatedly until it returns 0. The map
+ * must not be inserted into or removed from while iterating.
+ *
+ * @param pos The iteration position, advanced past the returned entry.
+ * @param key Receives the entry's key, may be NULL.
+ * @param value Receives the entry's value, may be NULL.
+ * @param map The Ordered Hash Map to iterate.
+ *
+ * @returns 1 if an entry was returned, 0 once the end is reached.
+ */
+int ordered_next(unsigned int *pos, Key *key, Value *value, OrderedHashMap *map);
+
+#endif
@@ -0,0 +1,449 @@
+/**
+ * @file sequence.c
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief An indexed sequence with O(log n) insertion and removal anywhere.
+ *
+ */
+
+#include "sequence.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+/** The deepest the tree can grow; far more than 2^32 items need. */
+#define SEQUENCE_MAX_HEIGHT 16
+
+/** The size leaves are aligned to, so each chunk starts on a cache line. */
+#define SEQUENCE_CACHE_LINE 64
+
+/* Below these a chunk or node takes items or children from a neighbour,
+   or merges with it. */
+#define LEAF_MIN (SEQUENCE_LEAF_ITEMS / 4)
+#define NODE_MIN (SEQUENCE_FANOUT / 4)
+
+static SequenceLeaf *new_leaf(void) {
+    size_t bytes = (sizeof(SequenceLeaf) + SEQUENCE_CACHE_LINE - 1) & ~(size_t) (SEQUENCE_CACHE_LINE - 1);
+    SequenceLeaf *leaf = aligned_alloc(SEQUENCE_CACHE_LINE, bytes);
+    if (!leaf) return NULL;
+
+    leaf->count = 0;
+    leaf->prev = NULL;
+    leaf->next = NULL;
+    return leaf;
+}
+
+/*
+ * Frees the subtree under node, which is a leaf when height is 0, except
+ * for the leaf keep.
+ */
+static void free_tree(void *node, unsigned int height, SequenceLeaf *keep) {
+    if (height == 0) {
+        if (node != keep) free(node);
+        return;
+    }
+
+    SequenceNode *inner = node;
+    for (unsigned int i = 0; i < inner->count; i++) free_tree(inner->children[i], height - 1, keep);
+    free(inner);
+}
+
+static unsigned int sum_sizes(const SequenceNode *node) {
+    unsigned int total = 0;
+    for (unsigned int i = 0; i < node->count; i++) total += node->sizes[i];
+    return total;
+}
+
+static void insert_child(SequenceNode *node, unsigned int slot, void *child, unsigned int size) {
+    memmove(node->children + slot + 1, node->children + slot, (node->count - slot) * sizeof(void *));
+    memmove(node->sizes + slot + 1, node->sizes + slot, (node->count - slot) * sizeof(unsigned int));
+    node->children[slot] = child;
+    node->sizes[slot] = size;
+    node->count++;
+}
+
+static void remove_child(SequenceNode *node, unsigned int slot) {
+    node->count--;
+    memmove(node->children + slot, node->children + slot + 1, (node->count - slot) * sizeof(void *));
+    memmove(node->sizes + slot, node->sizes + slot + 1, (node->count - slot) * sizeof(unsigned int));
+}
+
+/*
+ * Walks down to the leaf holding index, subtracting the sizes of the
+ * children passed over; index is left as the position within the leaf.
+ * An index equal to the length lands at the end of the last leaf. The
+ * nodes and child slots on the way are recorded when path is given.
+ */
+static SequenceLeaf *descend(unsigned int *index, SequenceNode **path, unsigned int *slots, Sequence *seq) {
+    void *node = seq->root;
+
+    for (unsigned int level = 0; level < seq->height; level++) {
+        SequenceNode *inner = node;
+        unsigned int i = 0;
+        while (i + 1 < inner->count && *index >= inner->sizes[i]) *index -= inner->sizes[i++];
+
+        if (path) {
+            path[level] = inner;
+            slots[level] = i;
+        }
+        node = inner->children[i];
+    }
+    return node;
+}
+
+/*
+ * Finds the leaf holding an index below the length. The leaf last read
+ * and the one after it are tried before walking down from the root, so
+ * reads in order rarely touch the inner nodes.
+ */
+static SequenceLeaf *find_leaf(unsigned int index, unsigned int *at, Sequence *seq) {
+    SequenceLeaf *leaf = seq->_finger;
+
+    if (leaf) {
+        unsigned int offset = index - seq->_finger_start;
+        if (index >= seq->_finger_start && offset < leaf->count) {
+            *at = offset;
+            return leaf;
+        }
+        if (index >= seq->_finger_start && leaf->next && offset - leaf->count < leaf->next->count) {
+            seq->_finger_start += leaf->count;
+            seq->_finger = leaf->next;
+            *at = offset - leaf->count;
+            return leaf->next;
+        }
+    }
+
+    *at = index;
+    leaf = descend(at, NULL, NULL, seq);
+    seq->_finger = leaf;
+    seq->_finger_start = index - *at;
+    return leaf;
+}
+
+/*
+ * Evens out the child in slot with a neighbour: the two merge when they
+ * fit in one, and otherwise share their items or children equally. An
+ * only child, as appending leaves on the right edge, is left alone.
+ */
+static void rebalance(SequenceNode *parent, unsigned int slot, int leaves, Sequence *seq) {
+    if (parent->count < 2) return;
+
+    unsigned int l = slot > 0 ? slot - 1 : slot;
+    unsigned int r = l + 1;
+
+    if (leaves) {
+        SequenceLeaf *a = parent->children[l];
+        SequenceLeaf *b = parent->children[r];
+        unsigned int total = a->count + b->count;
+
+        if (total <= SEQUENCE_LEAF_ITEMS) {
+            memcpy(a->items + a->count, b->items, b->count * sizeof(Item));
+            a->count = total;
+            a->next = b->next;
+            if (b->next) b->next->prev = a;
+            else seq->last = a;
+            free(b);
+
+            remove_child(parent, r);
+            parent->sizes[l] = total;
+            return;
+        }
+
+        unsigned int want = total / 2;
+        if (a->count > want) {
+            unsigned int move = a->count - want;
+            memmove(b->items + move, b->items, b->count * sizeof(Item));
+            memcpy(b->items, a->items + want, move * sizeof(Item));
+        }
+        else {
+            unsigned int move = want - a->count;
+            memcpy(a->items + a->count, b->items, move * sizeof(Item));
+            memmove(b->items, b->items + move, (b->count - move) * sizeof(Item));
+        }
+        a->count = want;
+        b->count = total - want;
+
+        parent->sizes[l] = a->count;
+        parent->sizes[r] = b->count;
+        return;
+    }
+
+    SequenceNode *a = parent->children[l];
+    SequenceNode *b = parent->children[r];
+    unsigned int total = a->count + b->count;
+
+    if (total <= SEQUENCE_FANOUT) {
+        memcpy(a->children + a->count, b->children, b->count * sizeof(void *));
+        memcpy(a->sizes + a->count, b->sizes, b->count * sizeof(unsigned int));
+        a->count = total;
+        free(b);
+
+        remove_child(parent, r);
+        parent->sizes[l] = sum_sizes(a);
+        return;
+    }
+
+    unsigned int want = total / 2;
+    if (a->count > want) {
+        unsigned int move = a->count - want;
+        memmove(b->children + move, b->children, b->count * sizeof(void *));
+        memmove(b->sizes + move, b->sizes, b->count * sizeof(unsigned int));
+        memcpy(b->children, a->children + want, move * sizeof(void *));
+        memcpy(b->sizes, a->sizes + want, move * sizeof(unsigned int));
+    }
+    else {
+        unsigned int move = want - a->count;
+        memcpy(a->children + a->count, b->children, move * sizeof(void *));
+        memcpy(a->sizes + a->count, b->sizes, move * sizeof(unsigned int));
+        memmove(b->children, b->children + move, (b->count - move) * sizeof(void *));
+        memmove(b->sizes, b->sizes + move, (b->count - move) * sizeof(unsigned int));
+    }
+    a->count = want;
+    b->count = total - want;
+
+    parent->sizes[l] = sum_sizes(a);
+    parent->sizes[r] = sum_sizes(b);
+}
+
+Sequence *sequence_new(void) {
+    Sequence *seq = malloc(sizeof(Sequence));
+    if (!seq) return NULL;
+
+    SequenceLeaf *leaf = new_leaf();
+    if (!leaf) {
+        free(seq);
+        return NULL;
+    }
+
+    seq->length = 0;
+    seq->height = 0;
+    seq->root = leaf;
+    seq->first = leaf;
+    seq->last = leaf;
+    seq->_finger = NULL;
+    seq->_finger_start = 0;
+    return seq;
+}
+
+void sequence_free(Sequence *seq) {
+    if (!seq) return;
+    free_tree(seq->root, seq->height, NULL);
+    free(seq);
+}
+
+int sequence_insert(int index, Item item, Sequence *seq) {
+    SequenceNode *path[SEQUENCE_MAX_HEIGHT];
+    unsigned int slots[SEQUENCE_MAX_HEIGHT];
+    SequenceNode *spare[SEQUENCE_MAX_HEIGHT + 1];
+
+    if (index < 0 || (unsigned int) index > seq->length || seq->length == UINT_MAX) return FAILURE;
+
+    unsigned int at = (unsigned int) index;
+    SequenceLeaf *leaf = descend(&at, path, slots, seq);
+    seq->_finger = NULL;
+
+    if (leaf->count < SEQUENCE_LEAF_ITEMS) {
+        memmove(leaf->items + at + 1, leaf->items + at, (leaf->count - at) * sizeof(Item));
+        leaf->items[at] = item;
+        leaf->count++;
+
+        for (unsigned int level = 0; level < seq->height; level++) path[level]->sizes[slots[level]]++;
+        seq->length++;
+        return SUCCESS;
+    }
+
+    // The leaf splits, and so does each full node above it. Everything
+    // needed is allocated first, so running out of memory changes nothing.
+    unsigned int level = seq->height;
+    while (level > 0 && path[level - 1]->count == SEQUENCE_FANOUT) level--;
+    unsigned int needed = seq->height - level + (level == 0);
+    if (level == 0 && seq->height == SEQUENCE_MAX_HEIGHT) return FAILURE;
+
+    SequenceLeaf *right = new_leaf();
+    if (!right) return FAILURE;
+
+    for (unsigned int i = 0; i < needed; i++) {
+        spare[i] = malloc(sizeof(SequenceNode));
+        if (!spare[i]) {
+            while (i-- > 0) free(spare[i]);
+            free(right);
+            return FAILURE;
+        }
+    }
+
+    // Appending leaves the full nodes behind it full rather than half empty.
+    int at_end = !leaf->next && at == leaf->count;
+    unsigned int keep = at_end ? SEQUENCE_LEAF_ITEMS : SEQUENCE_LEAF_ITEMS / 2;
+
+    memcpy(right->items, leaf->items + keep, (SEQUENCE_LEAF_ITEMS - keep) * sizeof(Item));
+    right->count = SEQUENCE_LEAF_ITEMS - keep;
+    leaf->count = keep;
+
+    right->prev = leaf;
+    right->next = leaf->next;
+    if (leaf->next) leaf->next->prev = right;
+    else seq->last = right;
+    leaf->next = right;
+
+    SequenceLeaf *target = leaf;
+    if (at > keep || at_end) {
+        target = right;
+        at -= keep;
+    }
+    memmove(target->items + at + 1, target->items + at, (target->count - at) * sizeof(Item));
+    target->items[at] = item;
+    target->count++;
+
+    void *sibling = right;
+    unsigned int left_size = leaf->count;
+    unsigned int right_size = right->count;
+    unsigned int used = 0;
+
+    for (level = seq->height; level-- > 0;) {
+        SequenceNode *parent = path[level];
+        unsigned int slot = slots[level];
+
+        if (!sibling) {
+            parent->sizes[slot]++;
+            continue;
+        }
+
+        parent->sizes[slot] = left_size;
+        if (parent->count < SEQUENCE_FANOUT) {
+            insert_child(parent, slot + 1, sibling, right_size);
+            sibling = NULL;
+            continue;
+        }
+
+        SequenceNode *split = spare[used++];
+        unsigned int node_keep = at_end ? SEQUENCE_FANOUT : SEQUENCE_FANOUT / 2;
+
+        split->count = SEQUENCE_FANOUT - node_keep;
+        memcpy(split->children, parent->children + node_keep, split->count * sizeof(void *));
+        memcpy(split->sizes, parent->sizes + node_keep, split->count * sizeof(unsigned int));
+        parent->count = node_keep;
+
+        if (slot + 1 > node_keep || at_end) insert_child(split, slot + 1 - node_keep, sibling, right_size);
+        else insert_child(parent, slot + 1, sibling, right_size);
+
+        sibling = split;
+        left_size = sum_sizes(parent);
+        right_size = sum_sizes(split);
+    }
+
+    if (sibling) {
+        SequenceNode *root = spare[used++];
+        root->count = 2;
+        root->children[0] = seq->root;
+        root->children[1] = sibling;
+        root->sizes[0] = left_size;
+        root->sizes[1] = right_size;
+
+        seq->root = root;
+        seq->height++;
+    }
+
+    seq->length++;
+    return SUCCESS;
+}
+
+int sequence_append(Item item, Sequence *seq) {
+    SequenceLeaf *last = seq->last;
+
+    // With room in the last leaf, only the counts down the right edge
+    // change, and there is no searching for the leaf.
+    if (last->count < SEQUENCE_LEAF_ITEMS && seq->length < UINT_MAX) {
+        void *node = seq->root;
+        for (unsigned int level = 0; level < seq->height; level++) {
+            SequenceNode *inner = node;
+            inner->sizes[inner->count - 1]++;
+            node = inner->children[inner->count - 1];
+        }
+
+        last->items[last->count++] = item;
+        seq->length++;
+        return SUCCESS;
+    }
+    return sequence_insert((int) seq->length, item, seq);
+}
+
+int sequence_remove_index(int index, Sequence *seq) {
+    SequenceNode *path[SEQUENCE_MAX_HEIGHT];
+    unsigned int slots[SEQUENCE_MAX_HEIGHT];
+
+    if (index < 0 || (unsigned int) index >= seq->length) return FAILURE;
+
+    unsigned int at = (unsigned int) index;
+    SequenceLeaf *leaf = descend(&at, path, slots, seq);
+    seq->_finger = NULL;
+
+    memmove(leaf->items + at, leaf->items + at + 1, (leaf->count - at - 1) * sizeof(Item));
+    leaf->count--;
+
+    for (unsigned int level = 0; level < seq->height; level++) path[level]->sizes[slots[level]]--;
+    seq->length--;
+
+    // Underfull children are evened out with a neighbour, from the bottom
+    // up, for as long as that leaves their parent underfull in turn.
+    unsigned int count = leaf->count;
+    unsigned int minimum = LEAF_MIN;
+    for (unsigned int level = seq->height; level-- > 0;) {
+        if (count >= minimum) break;
+
+        rebalance(path[level], slots[level], level + 1 == seq->height, seq);
+        count = path[level]->count;
+        minimum = NODE_MIN;
+    }
+
+    while (seq->height > 0 && ((SequenceNode *) seq->root)->count == 1) {
+        SequenceNode *old = seq->root;
+        seq->root = old->children[0];
+        seq->height--;
+        free(old);
+    }
+
+    return SUCCESS;
+}
+
+Item sequence_get(int index, Sequence *seq) {
+    unsigned int at;
+
+    if (index < 0 || (unsigned int) index >= seq->length) return (Item) 0;
+    return find_leaf((unsigned int) index, &at, seq)->items[at];
+}
+
+int sequence_set(int index, Item item, Sequence *seq) {
+    unsigned int at;
+
+    if (index < 0 || (unsigned int) index >= seq->length) return FAILURE;
+    find_leaf((unsigned int) index, &at, seq)->items[at] = item;
+    return SUCCESS;
+}
+
+Item *sequence_chunk(int index, unsigned int *count, Sequence *seq) {
+    unsigned int at;
+
+    if (index < 0 || (unsigned int) index >= seq->length) {
+        *count = 0;
+        return NULL;
+    }
+
+    SequenceLeaf *leaf = find_leaf((unsigned int) index, &at, seq);
+    *count = leaf->count - at;
+    return leaf->items + at;
+}
+
+void sequence_clear(Sequence *seq) {
+    SequenceLeaf *first = seq->first;
+
+    free_tree(seq->root, seq->height, first);
+    first->count = 0;
+    first->next = NULL;
+
+    seq->length = 0;
+    seq->height = 0;
+    seq->root = first;
+    seq->last = first;
+    seq->_finger = NULL;
+}
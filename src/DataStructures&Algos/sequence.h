@@ -0,0 +1,171 @@
+/**
+ * @file sequence.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief An indexed sequence with O(log n) insertion and removal anywhere.
+ *
+ * A Sequence offers the Array List's get, insert and remove_index by
+ * position, but keeps its items in small chunks, the leaves of a counted
+ * B+tree. Each inner node records how many items lie under each of its
+ * children, so an index is found by walking down and subtracting. An
+ * insert or removal moves items within one chunk and adjusts the counts
+ * on its path, rather than shifting the whole tail of the list.
+ *
+ * The chunks are linked in order, so iterating stays a walk over
+ * contiguous arrays: follow first and next, or use sequence_chunk. get
+ * also remembers the last chunk it read, so reading the items in order
+ * costs O(1) each.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_SEQUENCE_H
+#define WESTLEY_SEQUENCE_H
+
+#include "array_list.h"
+
+// Define SEQUENCE_LEAF_BYTES before the include to change the size of the
+// chunks, in bytes. Keep it a multiple of the cache line.
+#ifndef SEQUENCE_LEAF_BYTES
+#define SEQUENCE_LEAF_BYTES 512
+#endif
+
+/** The number of items a chunk holds. */
+#define SEQUENCE_LEAF_ITEMS (SEQUENCE_LEAF_BYTES / sizeof(Item) > 4 ? SEQUENCE_LEAF_BYTES / sizeof(Item) : 4)
+
+/** The most children an inner node has. */
+#define SEQUENCE_FANOUT 32
+
+/**
+ * @brief A chunk of consecutive items, a leaf of the tree.
+ */
+typedef struct sequenceLeaf {
+    Item items[SEQUENCE_LEAF_ITEMS];
+    /** The number of items held */
+    unsigned int count;
+    /** The neighbouring chunks in order */
+    struct sequenceLeaf *prev;
+    struct sequenceLeaf *next;
+} SequenceLeaf;
+
+/**
+ * @brief An inner node of the tree.
+ */
+typedef struct sequenceNode {
+    /** The number of items under each child */
+    unsigned int sizes[SEQUENCE_FANOUT];
+    /** The children, SequenceNodes or, on the lowest level, SequenceLeafs */
+    void *children[SEQUENCE_FANOUT];
+    /** The number of children */
+    unsigned int count;
+} SequenceNode;
+
+/**
+ * @brief Definition of a @ref Sequence.
+ */
+typedef struct sequence {
+    /** The number of items */
+    unsigned int length;
+    /** The number of inner levels, 0 when root is a leaf */
+    unsigned int height;
+    /** The top of the tree */
+    void *root;
+    /** The chunks at either end */
+    SequenceLeaf *first;
+    SequenceLeaf *last;
+    /** The chunk get last read, NULL after any change of shape */
+    SequenceLeaf *_finger;
+    /** The index of the first item of _finger */
+    unsigned int _finger_start;
+} Sequence;
+
+/**
+ * @brief Allocates a new, empty Sequence for use.
+ *
+ * @returns *Sequence
+ */
+Sequence *sequence_new(void);
+
+/**
+ * @brief Destroys a Sequence and frees the memory back.
+ *
+ * @param seq The Sequence to free.
+ */
+void sequence_free(Sequence *seq);
+
+/**
+ * @brief Add an item to a specified index of the Sequence.
+ *
+ * @param index The index where the item must be inserted.
+ * @param item The item to be inserted into the Sequence.
+ * @param seq The Sequence to insert to.
+ *
+ * @returns 1 if the insert was successful, 0 otherwise.
+ */
+int sequence_insert(int index, Item item, Sequence *seq);
+
+/**
+ * @brief Add an item to the end of the Sequence.
+ *
+ * Chunks filled by appending are left full, so a Sequence built this way
+ * is as dense as an array.
+ *
+ * @param item The item to be appended onto the Sequence.
+ * @param seq The Sequence to append.
+ *
+ * @returns 1 if the append was successful, 0 otherwise.
+ */
+int sequence_append(Item item, Sequence *seq);
+
+/**
+ * @brief Remove an item from a specific position of the Sequence.
+ *
+ * @param index The index of the item to be removed.
+ * @param seq The Sequence to be removed from.
+ *
+ * @returns 1 if the item was removed successfully, 0 otherwise.
+ */
+int sequence_remove_index(int index, Sequence *seq);
+
+/**
+ * @brief Gets the item in a particular index of a Sequence.
+ *
+ * @param index The index to look for.
+ * @param seq The Sequence to be evaluated.
+ *
+ * @returns The item, 0 if there is no item at that index.
+ */
+Item sequence_get(int index, Sequence *seq);
+
+/**
+ * @brief Replaces the item in a particular index of a Sequence.
+ *
+ * @param index The index of the item to replace.
+ * @param item The new item.
+ * @param seq The Sequence to be changed.
+ *
+ * @returns 1 if the item was replaced, 0 if there is no item at that index.
+ */
+int sequence_set(int index, Item item, Sequence *seq);
+
+/**
+ * @brief Gets the run of items stored contiguously from an index.
+ *
+ * @param index The index of the first item of the run.
+ * @param count Receives the number of items in the run.
+ * @param seq The Sequence to be read.
+ *
+ * @returns The run, NULL if there is no item at that index. It stays valid until the Sequence changes.
+ */
+Item *sequence_chunk(int index, unsigned int *count, Sequence *seq);
+
+/**
+ * @brief Empties a Sequence.
+ *
+ * @param seq The Sequence to be emptied.
+ */
+void sequence_clear(Sequence *seq);
+
+#endif
@@ -0,0 +1,288 @@
+/**
+ * @file simd_search.c
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief Vectorised find and count over arrays of numbers.
+ *
+ */
+
+#include "simd_search.h"
+#include <math.h>
+#include <stdatomic.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SEARCH_X86
+#endif
+
+typedef struct searchKernels {
+    int isa;
+    long (*find_f64)(const double *, size_t, double, double);
+    size_t (*count_f64)(const double *, size_t, double, double);
+    long (*find_f64_near)(const double *, size_t, double, double);
+    size_t (*count_f64_near)(const double *, size_t, double, double);
+    long (*find_f32)(const float *, size_t, float, float);
+    size_t (*count_f32)(const float *, size_t, float, float);
+    long (*find_f32_near)(const float *, size_t, float, float);
+    size_t (*count_f32_near)(const float *, size_t, float, float);
+    long (*find_i32)(const int32_t *, size_t, int32_t, int32_t);
+    size_t (*count_i32)(const int32_t *, size_t, int32_t, int32_t);
+    long (*find_i64)(const int64_t *, size_t, int64_t, int64_t);
+    size_t (*count_i64)(const int64_t *, size_t, int64_t, int64_t);
+} SearchKernels;
+
+#define EQUAL(a, x, eps) ((a) == (x))
+#define NEAR(a, x, eps) (fabs((a) - (x)) < (eps))
+#define NEAR_F32(a, x, eps) (fabsf((a) - (x)) < (eps))
+
+#define SCALAR_KERNELS(name, T, MATCH)                                              \
+    static long name##_find(const T *a, size_t n, T x, T eps) {                    \
+        (void) eps;                                                                 \
+        for (size_t i = 0; i < n; i++) {                                            \
+            if (MATCH(a[i], x, eps)) return (long) i;                               \
+        }                                                                           \
+        return -1;                                                                  \
+    }                                                                               \
+                                                                                    \
+    static size_t name##_count(const T *a, size_t n, T x, T eps) {                 \
+        (void) eps;                                                                 \
+        size_t total = 0;                                                           \
+        for (size_t i = 0; i < n; i++) total += MATCH(a[i], x, eps);                \
+        return total;                                                               \
+    }
+
+/*
+ * Generates the find and count kernels of one instruction set for one
+ * element type. SETUP broadcasts the value looked for, MATCH(p) gives a
+ * bitmask of the lanes of the vector at p that match, BITS counts the
+ * bits of such a mask, and SCALAR compares the items past the last whole
+ * vector. find tests four vectors per iteration so that only one branch
+ * is taken per 4 * LANES items.
+ */
+#define VECTOR_KERNELS(name, T, LANES, ISA, SETUP, MATCH, BITS, SCALAR)            \
+    __attribute__((target(ISA)))                                                    \
+    static long name##_find(const T *a, size_t n, T x, T eps) {                    \
+        (void) eps;                                                                 \
+        SETUP                                                                       \
+        size_t i = 0;                                                               \
+        for (; i + 4 * LANES <= n; i += 4 * LANES) {                                \
+            unsigned int m0 = MATCH(a + i);                                         \
+            unsigned int m1 = MATCH(a + i + LANES);                                 \
+            unsigned int m2 = MATCH(a + i + 2 * LANES);                             \
+            unsigned int m3 = MATCH(a + i + 3 * LANES);                             \
+            if (m0 | m1 | m2 | m3) {                                                \
+                if (m0) return (long) (i + __builtin_ctz(m0));                      \
+                if (m1) return (long) (i + LANES + __builtin_ctz(m1));              \
+                if (m2) return (long) (i + 2 * LANES + __builtin_ctz(m2));          \
+                return (long) (i + 3 * LANES + __builtin_ctz(m3));                  \
+            }                                                                       \
+        }                                                                           \
+        for (; i + LANES <= n; i += LANES) {                                        \
+            unsigned int m = MATCH(a + i);                                          \
+            if (m) return (long) (i + __builtin_ctz(m));                            \
+        }                                                                           \
+        for (; i < n; i++) {                                                        \
+            if (SCALAR(a[i], x, eps)) return (long) i;                              \
+        }                                                                           \
+        return -1;                                                                  \
+    }                                                                               \
+                                                                                    \
+    __attribute__((target(ISA)))                                                    \
+    static size_t name##_count(const T *a, size_t n, T x, T eps) {                 \
+        (void) eps;                                                                 \
+        SETUP                                                                       \
+        size_t i = 0, total = 0;                                                    \
+        for (; i + LANES <= n; i += LANES) total += BITS(MATCH(a + i));             \
+        for (; i < n; i++) total += SCALAR(a[i], x, eps);                           \
+        return total;                                                               \
+    }
+
+#define KERNEL_TABLE(prefix, ISA_ID) {                                              \
+    ISA_ID,                                                                         \
+    prefix##_f64_find, prefix##_f64_count,                                          \
+    prefix##_f64_near_find, prefix##_f64_near_count,                                \
+    prefix##_f32_find, prefix##_f32_count,                                          \
+    prefix##_f32_near_find, prefix##_f32_near_count,                                \
+    prefix##_i32_find, prefix##_i32_count,                                          \
+    prefix##_i64_find, prefix##_i64_count                                           \
+}
+
+SCALAR_KERNELS(scalar_f64, double, EQUAL)
+SCALAR_KERNELS(scalar_f64_near, double, NEAR)
+SCALAR_KERNELS(scalar_f32, float, EQUAL)
+SCALAR_KERNELS(scalar_f32_near, float, NEAR_F32)
+SCALAR_KERNELS(scalar_i32, int32_t, EQUAL)
+SCALAR_KERNELS(scalar_i64, int64_t, EQUAL)
+
+static const SearchKernels scalar_kernels = KERNEL_TABLE(scalar, SEARCH_SCALAR);
+
+#ifdef SEARCH_X86
+
+/* SSE2 masks have at most four bits, and a CPU without popcnt would pay for a call per mask. */
+static const unsigned char nibble_bits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 };
+#define NIBBLE_BITS(m) nibble_bits[m]
+
+/* SSE2 has no 64-bit compare: two lanes match when both of their halves do. */
+__attribute__((target("sse2")))
+static inline unsigned int sse2_eq64(const int64_t *p, __m128i v) {
+    __m128i halves = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *) p), v);
+    __m128i both = _mm_and_si128(halves, _mm_shuffle_epi32(halves, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_movemask_pd(_mm_castsi128_pd(both));
+}
+
+#define SSE2_F64(p) _mm_movemask_pd(_mm_cmpeq_pd(_mm_loadu_pd(p), v))
+#define SSE2_F64_NEAR(p) _mm_movemask_pd(_mm_cmplt_pd(_mm_andnot_pd(sign, _mm_sub_pd(_mm_loadu_pd(p), v)), e))
+#define SSE2_F32(p) _mm_movemask_ps(_mm_cmpeq_ps(_mm_loadu_ps(p), v))
+#define SSE2_F32_NEAR(p) _mm_movemask_ps(_mm_cmplt_ps(_mm_andnot_ps(sign, _mm_sub_ps(_mm_loadu_ps(p), v)), e))
+#define SSE2_I32(p) _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(_mm_loadu_si128((const __m128i *) (p)), v)))
+#define SSE2_I64(p) sse2_eq64(p, v)
+
+VECTOR_KERNELS(sse2_f64, double, 2, "sse2",
+    __m128d v = _mm_set1_pd(x);, SSE2_F64, NIBBLE_BITS, EQUAL)
+VECTOR_KERNELS(sse2_f64_near, double, 2, "sse2",
+    __m128d v = _mm_set1_pd(x); __m128d e = _mm_set1_pd(eps); __m128d sign = _mm_set1_pd(-0.0);,
+    SSE2_F64_NEAR, NIBBLE_BITS, NEAR)
+VECTOR_KERNELS(sse2_f32, float, 4, "sse2",
+    __m128 v = _mm_set1_ps(x);, SSE2_F32, NIBBLE_BITS, EQUAL)
+VECTOR_KERNELS(sse2_f32_near, float, 4, "sse2",
+    __m128 v = _mm_set1_ps(x); __m128 e = _mm_set1_ps(eps); __m128 sign = _mm_set1_ps(-0.0f);,
+    SSE2_F32_NEAR, NIBBLE_BITS, NEAR_F32)
+VECTOR_KERNELS(sse2_i32, int32_t, 4, "sse2",
+    __m128i v = _mm_set1_epi32(x);, SSE2_I32, NIBBLE_BITS, EQUAL)
+VECTOR_KERNELS(sse2_i64, int64_t, 2, "sse2",
+    __m128i v = _mm_set1_epi64x(x);, SSE2_I64, NIBBLE_BITS, EQUAL)
+
+static const SearchKernels sse2_kernels = KERNEL_TABLE(sse2, SEARCH_SSE2);
+
+#define AVX2_F64(p) _mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(p), v, _CMP_EQ_OQ))
+#define AVX2_F64_NEAR(p) _mm256_movemask_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_loadu_pd(p), v)), e, _CMP_LT_OQ))
+#define AVX2_F32(p) _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(p), v, _CMP_EQ_OQ))
+#define AVX2_F32_NEAR(p) _mm256_movemask_ps(_mm256_cmp_ps(_mm256_andnot_ps(sign, _mm256_sub_ps(_mm256_loadu_ps(p), v)), e, _CMP_LT_OQ))
+#define AVX2_I32(p) _mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_loadu_si256((const __m256i *) (p)), v)))
+#define AVX2_I64(p) _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(_mm256_loadu_si256((const __m256i *) (p)), v)))
+
+VECTOR_KERNELS(avx2_f64, double, 4, "avx2,popcnt",
+    __m256d v = _mm256_set1_pd(x);, AVX2_F64, __builtin_popcount, EQUAL)
+VECTOR_KERNELS(avx2_f64_near, double, 4, "avx2,popcnt",
+    __m256d v = _mm256_set1_pd(x); __m256d e = _mm256_set1_pd(eps); __m256d sign = _mm256_set1_pd(-0.0);,
+    AVX2_F64_NEAR, __builtin_popcount, NEAR)
+VECTOR_KERNELS(avx2_f32, float, 8, "avx2,popcnt",
+    __m256 v = _mm256_set1_ps(x);, AVX2_F32, __builtin_popcount, EQUAL)
+VECTOR_KERNELS(avx2_f32_near, float, 8, "avx2,popcnt",
+    __m256 v = _mm256_set1_ps(x); __m256 e = _mm256_set1_ps(eps); __m256 sign = _mm256_set1_ps(-0.0f);,
+    AVX2_F32_NEAR, __builtin_popcount, NEAR_F32)
+VECTOR_KERNELS(avx2_i32, int32_t, 8, "avx2,popcnt",
+    __m256i v = _mm256_set1_epi32(x);, AVX2_I32, __builtin_popcount, EQUAL)
+VECTOR_KERNELS(avx2_i64, int64_t, 4, "avx2,popcnt",
+    __m256i v = _mm256_set1_epi64x(x);, AVX2_I64, __builtin_popcount, EQUAL)
+
+static const SearchKernels avx2_kernels = KERNEL_TABLE(avx2, SEARCH_AVX2);
+
+#define AVX512_F64(p) _mm512_cmp_pd_mask(_mm512_loadu_pd(p), v, _CMP_EQ_OQ)
+#define AVX512_F64_NEAR(p) _mm512_cmp_pd_mask(_mm512_abs_pd(_mm512_sub_pd(_mm512_loadu_pd(p), v)), e, _CMP_LT_OQ)
+#define AVX512_F32(p) _mm512_cmp_ps_mask(_mm512_loadu_ps(p), v, _CMP_EQ_OQ)
+#define AVX512_F32_NEAR(p) _mm512_cmp_ps_mask(_mm512_abs_ps(_mm512_sub_ps(_mm512_loadu_ps(p), v)), e, _CMP_LT_OQ)
+#define AVX512_I32(p) _mm512_cmpeq_epi32_mask(_mm512_loadu_si512(p), v)
+#define AVX512_I64(p) _mm512_cmpeq_epi64_mask(_mm512_loadu_si512(p), v)
+
+VECTOR_KERNELS(avx512_f64, double, 8, "avx512f,popcnt",
+    __m512d v = _mm512_set1_pd(x);, AVX512_F64, __builtin_popcount, EQUAL)
+VECTOR_KERNELS(avx512_f64_near, double, 8, "avx512f,popcnt",
+    __m512d v = _mm512_set1_pd(x); __m512d e = _mm512_set1_pd(eps);,
+    AVX512_F64_NEAR, __builtin_popcount, NEAR)
+VECTOR_KERNELS(avx512_f32, float, 16, "avx512f,popcnt",
+    __m512 v = _mm512_set1_ps(x);, AVX512_F32, __builtin_popcount, EQUAL)
+VECTOR_KERNELS(avx512_f32_near, float, 16, "avx512f,popcnt",
+    __m512 v = _mm512_set1_ps(x); __m512 e = _mm512_set1_ps(eps);,
+    AVX512_F32_NEAR, __builtin_popcount, NEAR_F32)
+VECTOR_KERNELS(avx512_i32, int32_t, 16, "avx512f,popcnt",
+    __m512i v = _mm512_set1_epi32(x);, AVX512_I32, __builtin_popcount, EQUAL)
+VECTOR_KERNELS(avx512_i64, int64_t, 8, "avx512f,popcnt",
+    __m512i v = _mm512_set1_epi64(x);, AVX512_I64, __builtin_popcount, EQUAL)
+
+static const SearchKernels avx512_kernels = KERNEL_TABLE(avx512, SEARCH_AVX512);
+
+#endif
+
+static _Atomic(const SearchKernels *) selected;
+
+static const SearchKernels *kernels_for(int isa) {
+    switch (isa) {
+        case SEARCH_SCALAR: return &scalar_kernels;
+#ifdef SEARCH_X86
+        case SEARCH_SSE2: return __builtin_cpu_supports("sse2") ? &sse2_kernels : NULL;
+        case SEARCH_AVX2: return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt") ? &avx2_kernels : NULL;
+        case SEARCH_AVX512: return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("popcnt") ? &avx512_kernels : NULL;
+#endif
+        default: return NULL;
+    }
+}
+
+/*
+ * Picks the widest instruction set the CPU supports on first use. Threads
+ * racing here all store the same table, so no lock is needed.
+ */
+static const SearchKernels *kernels(void) {
+    const SearchKernels *k = atomic_load_explicit(&selected, memory_order_acquire);
+    if (k) return k;
+
+#ifdef SEARCH_X86
+    __builtin_cpu_init();
+#endif
+    for (int isa = SEARCH_AVX512; !k; isa--) k = kernels_for(isa);
+
+    atomic_store_explicit(&selected, k, memory_order_release);
+    return k;
+}
+
+int search_isa(void) {
+    return kernels()->isa;
+}
+
+int search_set_isa(int isa) {
+#ifdef SEARCH_X86
+    __builtin_cpu_init();
+#endif
+    const SearchKernels *k = kernels_for(isa);
+    if (!k) return FAILURE;
+
+    atomic_store_explicit(&selected, k, memory_order_release);
+    return SUCCESS;
+}
+
+long search_find_f64(const double *items, size_t length, double item, double eps) {
+    const SearchKernels *k = kernels();
+    return eps > 0 ? k->find_f64_near(items, length, item, eps) : k->find_f64(items, length, item, 0);
+}
+
+size_t search_count_f64(const double *items, size_t length, double item, double eps) {
+    const SearchKernels *k = kernels();
+    return eps > 0 ? k->count_f64_near(items, length, item, eps) : k->count_f64(items, length, item, 0);
+}
+
+long search_find_f32(const float *items, size_t length, float item, float eps) {
+    const SearchKernels *k = kernels();
+    return eps > 0 ? k->find_f32_near(items, length, item, eps) : k->find_f32(items, length, item, 0);
+}
+
+size_t search_count_f32(const float *items, size_t length, float item, float eps) {
+    const SearchKernels *k = kernels();
+    return eps > 0 ? k->count_f32_near(items, length, item, eps) : k->count_f32(items, length, item, 0);
+}
+
+long search_find_i32(const int32_t *items, size_t length, int32_t item) {
+    return kernels()->find_i32(items, length, item, 0);
+}
+
+size_t search_count_i32(const int32_t *items, size_t length, int32_t item) {
+    return kernels()->count_i32(items, length, item, 0);
+}
+
+long search_find_i64(const int64_t *items, size_t length, int64_t item) {
+    return kernels()->find_i64(items, length, item, 0);
+}
+
+size_t search_count_i64(const int64_t *items, size_t length, int64_t item) {
+    return kernels()->count_i64(items, length, item, 0);
+}
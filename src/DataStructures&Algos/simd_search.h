@@ -0,0 +1,109 @@
+/**
+ * @file simd_search.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief Vectorised find and count over arrays of numbers.
+ *
+ * Each search comes in SSE2, AVX2 and AVX-512 versions alongside a plain
+ * loop. The widest one the CPU supports is picked the first time any of
+ * them is called. Floating values can be compared exactly or within an
+ * epsilon, integers are compared exactly.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_SIMD_SEARCH_H
+#define WESTLEY_SIMD_SEARCH_H
+
+#define SUCCESS 1
+#define FAILURE 0
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** The instruction sets a search can run on. */
+#define SEARCH_SCALAR 0
+#define SEARCH_SSE2 1
+#define SEARCH_AVX2 2
+#define SEARCH_AVX512 3
+
+/**
+ * @brief Gets the instruction set searches currently run on.
+ *
+ * @returns SEARCH_SCALAR, SEARCH_SSE2, SEARCH_AVX2 or SEARCH_AVX512.
+ */
+int search_isa(void);
+
+/**
+ * @brief Makes searches run on a given instruction set, e.g. to compare them.
+ *
+ * @param isa SEARCH_SCALAR, SEARCH_SSE2, SEARCH_AVX2 or SEARCH_AVX512.
+ *
+ * @returns 1 if the CPU supports the instruction set and it was selected, 0 otherwise.
+ */
+int search_set_isa(int isa);
+
+/**
+ * @brief Finds the first double equal to, or within eps of, a value.
+ *
+ * @param items The array to search.
+ * @param length The number of items.
+ * @param item The value to look for.
+ * @param eps The largest difference, exclusive, counted as equal; 0 compares exactly.
+ *
+ * @returns The index of the first match, -1 if there is none.
+ */
+long search_find_f64(const double *items, size_t length, double item, double eps);
+
+/**
+ * @brief Counts the doubles equal to, or within eps of, a value.
+ *
+ * @returns The number of matches.
+ */
+size_t search_count_f64(const double *items, size_t length, double item, double eps);
+
+/**
+ * @brief Finds the first float equal to, or within eps of, a value.
+ *
+ * @returns The index of the first match, -1 if there is none.
+ */
+long search_find_f32(const float *items, size_t length, float item, float eps);
+
+/**
+ * @brief Counts the floats equal to, or within eps of, a value.
+ *
+ * @returns The number of matches.
+ */
+size_t search_count_f32(const float *items, size_t length, float item, float eps);
+
+/**
+ * @brief Finds the first 32-bit integer equal to a value.
+ *
+ * @returns The index of the first match, -1 if there is none.
+ */
+long search_find_i32(const int32_t *items, size_t length, int32_t item);
+
+/**
+ * @brief Counts the 32-bit integers equal to a value.
+ *
+ * @returns The number of matches.
+ */
+size_t search_count_i32(const int32_t *items, size_t length, int32_t item);
+
+/**
+ * @brief Finds the first 64-bit integer equal to a value.
+ *
+ * @returns The index of the first match, -1 if there is none.
+ */
+long search_find_i64(const int64_t *items, size_t length, int64_t item);
+
+/**
+ * @brief Counts the 64-bit integers equal to a value.
+ *
+ * @returns The number of matches.
+ */
+size_t search_count_i64(const int64_t *items, size_t length, int64_t item);
+
+#endif
@@ -0,0 +1,409 @@
+/**
+ * @file sort.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief Generators for type-specialised sorting functions.
+ *
+ * DEFINE_SORT(name, T, less) emits static inline functions sorting arrays
+ * of T, for example:
+ *
+ *     #define DOUBLE_LESS(a, b) ((a) < (b))
+ *     DEFINE_SORT(doubles, double, DOUBLE_LESS)
+ *
+ *     doubles_pdqsort(array, length);
+ *
+ * less(a, b) must return non-zero when a orders before b. It is expanded
+ * in place, so the compiler inlines every comparison.
+ *
+ * name_pdqsort is a pattern-defeating quicksort: median-of-three or
+ * ninther pivots, a switch to insertion sort on small and nearly sorted
+ * ranges, a separate pass for runs of items equal to the pivot, and a
+ * heapsort fallback once too many partitions come out unbalanced, which
+ * bounds it to O(n log n). It is not stable.
+ *
+ * name_merge_sort is a stable bottom-up merge sort. It allocates nothing:
+ * the caller passes a scratch buffer as long as the array. name_merge and
+ * name_merge_split merge two sorted runs, whole or in pieces, so callers
+ * can spread one merge across several threads.
+ *
+ * LSD radix sorts are also defined for 32 and 64-bit integers and IEEE-754
+ * floats, under the names sort_i32_radix, sort_u64_radix, sort_f64_radix
+ * and so on. They order -0.0 before 0.0 and NaNs with a clear sign bit
+ * after every number.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_SORT_H
+#define WESTLEY_SORT_H
+
+#define TRUE 1
+#define FALSE 0
+
+#define SUCCESS 1
+#define FAILURE 0
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/** Ranges shorter than this are insertion sorted. */
+#define SORT_INSERTION_THRESHOLD 24
+
+/** Ranges longer than this take the median of three medians as pivot. */
+#define SORT_NINTHER_THRESHOLD 128
+
+/** The number of moves a partial insertion sort may make before giving up. */
+#define SORT_PARTIAL_INSERTION_LIMIT 8
+
+/** The length of the runs merge sort insertion sorts before it starts merging. */
+#define SORT_MERGE_RUN 32
+
+#define DEFINE_SORT(name, T, less)                                                      \
+                                                                                        \
+static inline void name##_swap_(T *a, T *b) {                                           \
+    T tmp = *a;                                                                         \
+    *a = *b;                                                                            \
+    *b = tmp;                                                                           \
+}                                                                                       \
+                                                                                        \
+static inline void name##_insertion_sort(T *a, size_t n) {                              \
+    for (size_t i = 1; i < n; i++) {                                                    \
+        T tmp = a[i];                                                                   \
+        size_t j = i;                                                                   \
+        while (j > 0 && less(tmp, a[j - 1])) {                                          \
+            a[j] = a[j - 1];                                                            \
+            j--;                                                                        \
+        }                                                                               \
+        a[j] = tmp;                                                                     \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+/* Insertion sort for a range whose predecessor orders before all of it. */            \
+static inline void name##_unguarded_insertion_sort_(T *begin, T *end) {                 \
+    for (T *cur = begin + 1; cur < end; cur++) {                                        \
+        T tmp = *cur;                                                                   \
+        T *sift = cur;                                                                  \
+        while (less(tmp, sift[-1])) {                                                   \
+            *sift = sift[-1];                                                           \
+            sift--;                                                                     \
+        }                                                                               \
+        *sift = tmp;                                                                    \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+/* Insertion sorts a range unless it takes too many moves; returns TRUE if sorted. */   \
+static inline int name##_partial_insertion_sort_(T *begin, T *end) {                    \
+    size_t moves = 0;                                                                   \
+    for (T *cur = begin + 1; cur < end; cur++) {                                        \
+        if (!less(*cur, cur[-1])) continue;                                             \
+        T tmp = *cur;                                                                   \
+        T *sift = cur;                                                                  \
+        do {                                                                            \
+            *sift = sift[-1];                                                           \
+            sift--;                                                                     \
+        } while (sift != begin && less(tmp, sift[-1]));                                 \
+        *sift = tmp;                                                                    \
+        moves += cur - sift;                                                            \
+        if (moves > SORT_PARTIAL_INSERTION_LIMIT) return FALSE;                         \
+    }                                                                                   \
+    return TRUE;                                                                        \
+}                                                                                       \
+                                                                                        \
+static inline void name##_sift_down_(T *a, size_t root, size_t n) {                     \
+    T tmp = a[root];                                                                    \
+    size_t child;                                                                       \
+    while ((child = 2 * root + 1) < n) {                                                \
+        if (child + 1 < n && less(a[child], a[child + 1])) child++;                     \
+        if (!less(tmp, a[child])) break;                                                \
+        a[root] = a[child];                                                             \
+        root = child;                                                                   \
+    }                                                                                   \
+    a[root] = tmp;                                                                      \
+}                                                                                       \
+                                                                                        \
+static inline void name##_heap_sort(T *a, size_t n) {                                   \
+    for (size_t i = n / 2; i > 0; i--) name##_sift_down_(a, i - 1, n);                  \
+    for (size_t i = n; i > 1; i--) {                                                    \
+        name##_swap_(&a[0], &a[i - 1]);                                                 \
+        name##_sift_down_(a, 0, i - 1);                                                 \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+static inline void name##_sort3_(T *a, T *b, T *c) {                                    \
+    if (less(*b, *a)) name##_swap_(a, b);                                               \
+    if (less(*c, *b)) name##_swap_(b, c);                                               \
+    if (less(*b, *a)) name##_swap_(a, b);                                               \
+}                                                                                       \
+                                                                                        \
+/*                                                                                      \
+ * Partitions around *begin, items equal to the pivot going right. The                  \
+ * median selection left an item no less than the pivot at end - 1, so the             \
+ * first scan needs no bounds check. Sets already when no swap was needed.              \
+ */                                                                                     \
+static inline T *name##_partition_right_(T *begin, T *end, int *already) {              \
+    T pivot = *begin;                                                                   \
+    T *first = begin;                                                                   \
+    T *last = end;                                                                      \
+                                                                                        \
+    while (less(*++first, pivot));                                                      \
+    if (first - 1 == begin) while (first < last && !less(*--last, pivot));              \
+    else while (!less(*--last, pivot));                                                 \
+                                                                                        \
+    *already = first >= last;                                                           \
+    while (first < last) {                                                              \
+        name##_swap_(first, last);                                                      \
+        while (less(*++first, pivot));                                                  \
+        while (!less(*--last, pivot));                                                  \
+    }                                                                                   \
+                                                                                        \
+    T *pivot_pos = first - 1;                                                           \
+    *begin = *pivot_pos;                                                                \
+    *pivot_pos = pivot;                                                                 \
+    return pivot_pos;                                                                   \
+}                                                                                       \
+                                                                                        \
+/*                                                                                      \
+ * Partitions around *begin with items equal to the pivot going left. Used             \
+ * when the pivot equals the item before the range, so the whole left part             \
+ * is equal and needs no further sorting.                                               \
+ */                                                                                     \
+static inline T *name##_partition_left_(T *begin, T *end) {                             \
+    T pivot = *begin;                                                                   \
+    T *first = begin;                                                                   \
+    T *last = end;                                                                      \
+                                                                                        \
+    while (less(pivot, *--last));                                                       \
+    if (last + 1 == end) while (first < last && !less(pivot, *++first));                \
+    else while (!less(pivot, *++first));                                                \
+                                                                                        \
+    while (first < last) {                                                              \
+        name##_swap_(first, last);                                                      \
+        while (less(pivot, *--last));                                                   \
+        while (!less(pivot, *++first));                                                 \
+    }                                                                                   \
+                                                                                        \
+    *begin = *last;                                                                     \
+    *last = pivot;                                                                      \
+    return last;                                                                        \
+}                                                                                       \
+                                                                                        \
+static inline void name##_pdqsort_loop_(T *begin, T *end, int bad_allowed, int leftmost) { \
+    for (;;) {                                                                          \
+        size_t size = end - begin;                                                      \
+        if (size < SORT_INSERTION_THRESHOLD) {                                          \
+            if (leftmost) name##_insertion_sort(begin, size);                           \
+            else name##_unguarded_insertion_sort_(begin, end);                          \
+            return;                                                                     \
+        }                                                                               \
+                                                                                        \
+        size_t half = size / 2;                                                         \
+        if (size > SORT_NINTHER_THRESHOLD) {                                            \
+            name##_sort3_(begin, begin + half, end - 1);                                \
+            name##_sort3_(begin + 1, begin + (half - 1), end - 2);                      \
+            name##_sort3_(begin + 2, begin + (half + 1), end - 3);                      \
+            name##_sort3_(begin + (half - 1), begin + half, begin + (half + 1));        \
+            name##_swap_(begin, begin + half);                                          \
+        }                                                                               \
+        else name##_sort3_(begin + half, begin, end - 1);                               \
+                                                                                        \
+        if (!leftmost && !less(begin[-1], *begin)) {                                    \
+            begin = name##_partition_left_(begin, end) + 1;                             \
+            continue;                                                                   \
+        }                                                                               \
+                                                                                        \
+        int already;                                                                    \
+        T *pivot = name##_partition_right_(begin, end, &already);                       \
+        size_t left = pivot - begin;                                                    \
+        size_t right = end - (pivot + 1);                                               \
+                                                                                        \
+        if (left < size / 8 || right < size / 8) {                                      \
+            if (--bad_allowed == 0) {                                                   \
+                name##_heap_sort(begin, size);                                          \
+                return;                                                                 \
+            }                                                                           \
+            /* Break up whatever pattern made the pivot a poor one. */                  \
+            if (left >= SORT_INSERTION_THRESHOLD) {                                     \
+                name##_swap_(begin, begin + left / 4);                                  \
+                name##_swap_(pivot - 1, pivot - left / 4);                              \
+                if (left > SORT_NINTHER_THRESHOLD) {                                    \
+                    name##_swap_(begin + 1, begin + (left / 4 + 1));                    \
+                    name##_swap_(begin + 2, begin + (left / 4 + 2));                    \
+                    name##_swap_(pivot - 2, pivot - (left / 4 + 1));                    \
+                    name##_swap_(pivot - 3, pivot - (left / 4 + 2));                    \
+                }                                                                       \
+            }                                                                           \
+            if (right >= SORT_INSERTION_THRESHOLD) {                                    \
+                name##_swap_(pivot + 1, pivot + (1 + right / 4));                       \
+                name##_swap_(end - 1, end - right / 4);                                 \
+                if (right > SORT_NINTHER_THRESHOLD) {                                   \
+                    name##_swap_(pivot + 2, pivot + (2 + right / 4));                   \
+                    name##_swap_(pivot + 3, pivot + (3 + right / 4));                   \
+                    name##_swap_(end - 2, end - (1 + right / 4));                       \
+                    name##_swap_(end - 3, end - (2 + right / 4));                       \
+                }                                                                       \
+            }                                                                           \
+        }                                                                               \
+        else if (already                                                                \
+                 && name##_partial_insertion_sort_(begin, pivot)                        \
+                 && name##_partial_insertion_sort_(pivot + 1, end)) {                   \
+            return;                                                                     \
+        }                                                                               \
+                                                                                        \
+        name##_pdqsort_loop_(begin, pivot, bad_allowed, leftmost);                      \
+        begin = pivot + 1;                                                              \
+        leftmost = FALSE;                                                               \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+static inline void name##_pdqsort(T *a, size_t n) {                                     \
+    int bad_allowed = 1;                                                                \
+    for (size_t m = n; m > 1; m >>= 1) bad_allowed++;                                   \
+    if (n > 1) name##_pdqsort_loop_(a, a + n, bad_allowed, TRUE);                       \
+}                                                                                       \
+                                                                                        \
+/* Merges two sorted runs into out, taking from a first on ties. */                    \
+static inline void name##_merge(const T *a, size_t na, const T *b, size_t nb, T *out) { \
+    size_t i = 0, j = 0;                                                                \
+    while (i < na && j < nb) {                                                          \
+        if (less(b[j], a[i])) *out++ = b[j++];                                          \
+        else *out++ = a[i++];                                                           \
+    }                                                                                   \
+    memcpy(out, a + i, (na - i) * sizeof(T));                                           \
+    memcpy(out + (na - i), b + j, (nb - j) * sizeof(T));                                \
+}                                                                                       \
+                                                                                        \
+/*                                                                                      \
+ * Finds how many of the first k items of the merge of a and b come from a,             \
+ * by binary search on the merge path. Merging a[i0, i1) with b[k0 - i0,                \
+ * k1 - i1), where i0 and i1 are the splits at k0 and k1, yields exactly               \
+ * items k0 to k1 of the whole merge.                                                   \
+ */                                                                                     \
+static inline size_t name##_merge_split(const T *a, size_t na, const T *b, size_t nb, size_t k) { \
+    size_t lo = k > nb ? k - nb : 0;                                                    \
+    size_t hi = k < na ? k : na;                                                        \
+    while (lo < hi) {                                                                   \
+        size_t i = lo + (hi - lo) / 2;                                                  \
+        /* a[i] is among the first k when it orders no later than b[k - i - 1]. */      \
+        if (!less(b[k - i - 1], a[i])) lo = i + 1;                                      \
+        else hi = i;                                                                    \
+    }                                                                                   \
+    return lo;                                                                          \
+}                                                                                       \
+                                                                                        \
+/* Stable merge sort of a, using scratch (n items) as the other merge buffer. */       \
+static inline void name##_merge_sort(T *a, size_t n, T *scratch) {                      \
+    for (size_t i = 0; i < n; i += SORT_MERGE_RUN) {                                    \
+        name##_insertion_sort(a + i, n - i < SORT_MERGE_RUN ? n - i : SORT_MERGE_RUN);  \
+    }                                                                                   \
+                                                                                        \
+    T *src = a;                                                                         \
+    T *dst = scratch;                                                                   \
+    for (size_t width = SORT_MERGE_RUN; width < n; width *= 2) {                        \
+        for (size_t lo = 0; lo < n; lo += 2 * width) {                                  \
+            size_t mid = n - lo < width ? n : lo + width;                               \
+            size_t hi = n - mid < width ? n : mid + width;                              \
+            /* Runs already in order are copied without comparing. */                  \
+            if (mid == hi || !less(src[mid], src[mid - 1])) {                           \
+                memcpy(dst + lo, src + lo, (hi - lo) * sizeof(T));                      \
+            }                                                                           \
+            else name##_merge(src + lo, mid - lo, src + mid, hi - mid, dst + lo);       \
+        }                                                                               \
+        T *tmp = src;                                                                   \
+        src = dst;                                                                      \
+        dst = tmp;                                                                      \
+    }                                                                                   \
+                                                                                        \
+    if (src != a) memcpy(a, src, n * sizeof(T));                                        \
+}
+
+/*
+ * DEFINE_RADIX_SORT(name, T, U, key) emits name_radix, an LSD radix sort
+ * over arrays of T using key(x), an unsigned U ordered like x, one byte
+ * per pass. Passes in which every item has the same byte are skipped.
+ * Returns FAILURE, leaving the array untouched, if the scratch buffer
+ * cannot be allocated.
+ */
+#define DEFINE_RADIX_SORT(name, T, U, key)                                              \
+                                                                                        \
+static inline int name##_radix(T *a, size_t n) {                                        \
+    if (n < 2) return SUCCESS;                                                          \
+                                                                                        \
+    T *scratch = malloc(n * sizeof(T));                                                 \
+    if (!scratch) return FAILURE;                                                       \
+                                                                                        \
+    size_t counts[sizeof(U)][256];                                                      \
+    memset(counts, 0, sizeof(counts));                                                  \
+    for (size_t i = 0; i < n; i++) {                                                    \
+        U k = key(a[i]);                                                                \
+        for (unsigned int b = 0; b < sizeof(U); b++) counts[b][(k >> (8 * b)) & 0xFF]++; \
+    }                                                                                   \
+                                                                                        \
+    T *src = a;                                                                         \
+    T *dst = scratch;                                                                   \
+    U first = key(a[0]);                                                                \
+                                                                                        \
+    for (unsigned int b = 0; b < sizeof(U); b++) {                                      \
+        size_t *count = counts[b];                                                      \
+        unsigned int shift = 8 * b;                                                     \
+        if (count[(first >> shift) & 0xFF] == n) continue;                              \
+                                                                                        \
+        size_t offset = 0;                                                              \
+        for (int d = 0; d < 256; d++) {                                                 \
+            size_t c = count[d];                                                        \
+            count[d] = offset;                                                          \
+            offset += c;                                                                \
+        }                                                                               \
+                                                                                        \
+        for (size_t i = 0; i < n; i++) dst[count[(key(src[i]) >> shift) & 0xFF]++] = src[i]; \
+                                                                                        \
+        T *tmp = src;                                                                   \
+        src = dst;                                                                      \
+        dst = tmp;                                                                      \
+    }                                                                                   \
+                                                                                        \
+    if (src != a) memcpy(a, src, n * sizeof(T));                                        \
+    free(scratch);                                                                      \
+    return SUCCESS;                                                                     \
+}
+
+static inline uint32_t sort_key_u32(uint32_t x) {
+    return x;
+}
+
+static inline uint64_t sort_key_u64(uint64_t x) {
+    return x;
+}
+
+/* Flipping the sign bit orders two's complement integers as unsigned ones. */
+static inline uint32_t sort_key_i32(int32_t x) {
+    return (uint32_t) x ^ 0x80000000u;
+}
+
+static inline uint64_t sort_key_i64(int64_t x) {
+    return (uint64_t) x ^ 0x8000000000000000ull;
+}
+
+/* Negative floats have every bit flipped, so larger magnitudes order first; others only the sign bit. */
+static inline uint32_t sort_key_f32(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits ^ (-(bits >> 31) | 0x80000000u);
+}
+
+static inline uint64_t sort_key_f64(double x) {
+    uint64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    return bits ^ (-(bits >> 63) | 0x8000000000000000ull);
+}
+
+DEFINE_RADIX_SORT(sort_u32, uint32_t, uint32_t, sort_key_u32)
+DEFINE_RADIX_SORT(sort_u64, uint64_t, uint64_t, sort_key_u64)
+DEFINE_RADIX_SORT(sort_i32, int32_t, uint32_t, sort_key_i32)
+DEFINE_RADIX_SORT(sort_i64, int64_t, uint64_t, sort_key_i64)
+DEFINE_RADIX_SORT(sort_f32, float, uint32_t, sort_key_f32)
+DEFINE_RADIX_SORT(sort_f64, double, uint64_t, sort_key_f64)
+
+#endif
@@ -0,0 +1,231 @@
+/**
+ * @file sorted_list.c
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief An Array List kept in ascending order, searched in O(log n).
+ *
+ */
+
+#include "sorted_list.h"
+#include <stdlib.h>
+
+#define ITEM_IS_FLOATING _Generic((Item) 0, float: TRUE, double: TRUE, long double: TRUE, default: FALSE)
+
+/** The number of Items on a cache line, the spacing of the nodes the index search prefetches. */
+#define ITEMS_PER_LINE (SORTED_LIST_CACHE_LINE / sizeof(Item) ? SORTED_LIST_CACHE_LINE / sizeof(Item) : 1)
+
+/* Which items a search passes over: those less than the value, those not
+   greater, or those less and not within ARRAY_LIST_EPSILON of it. */
+#define BOUND_LOWER 0
+#define BOUND_UPPER 1
+#define BOUND_NEAR 2
+
+/*
+ * Compares floating Items in their own precision, the same way the
+ * BOUND_NEAR search does, so the two agree at the edge of epsilon.
+ */
+static int same_item(Item a, Item b) {
+    if (ITEM_IS_FLOATING && ARRAY_LIST_EPSILON > 0) return (a < b ? b - a : a - b) < ARRAY_LIST_EPSILON;
+    return a == b;
+}
+
+static inline int goes_before(Item a, Item x, int mode) {
+    if (mode == BOUND_UPPER) return !(x < a);
+    if (mode == BOUND_NEAR) return x - a >= ARRAY_LIST_EPSILON;
+    return a < x;
+}
+
+/*
+ * Branchless binary search of the sorted items. The range halves every
+ * step whatever the comparison says, so the loop runs a fixed number of
+ * times and the comparison only feeds a conditional move of base. Both
+ * midpoints the next step could read are prefetched.
+ */
+static inline unsigned int locate_sorted(const Item *items, unsigned int n, Item x, int mode) {
+    if (n == 0) return 0;
+
+    const Item *base = items;
+    while (n > 1) {
+        unsigned int half = n / 2;
+        __builtin_prefetch(base + half / 2);
+        __builtin_prefetch(base + half + half / 2);
+        base = goes_before(base[half], x, mode) ? base + half : base;
+        n -= half;
+    }
+    return (unsigned int) (base - items) + goes_before(*base, x, mode);
+}
+
+/*
+ * Search of the Eytzinger index. The walk goes down to a leaf, turning
+ * right past every item that goes before x; the answer is the last node
+ * where it turned left, found by stripping the trailing right turns
+ * (1 bits) and that left turn from k. Returns that node, 0 when every
+ * item goes before x. The prefetch fetches the line holding the
+ * descendants of k a few levels down, which all share it.
+ */
+static inline size_t locate_index(const Item *tree, size_t n, Item x, int mode) {
+    size_t k = 1;
+
+    while (k <= n) {
+        __builtin_prefetch(tree + k * ITEMS_PER_LINE);
+        k = 2 * k + goes_before(tree[k], x, mode);
+    }
+    return k >> __builtin_ffsll((long long) ~k);
+}
+
+/*
+ * Finds the first item that x does not go past. Returns where its value
+ * can be read, in the index when there is one, NULL past the end; the
+ * position it returns in *index is only looked up when index is given,
+ * sparing contains the read from ranks.
+ */
+static const Item *locate(Item x, int mode, unsigned int *index, SortedList *sorted) {
+    unsigned int n = sorted->list->length;
+
+    if (sorted->eytzinger) {
+        size_t k = locate_index(sorted->eytzinger, n, x, mode);
+        if (index) *index = k ? sorted->ranks[k] : n;
+        return k ? sorted->eytzinger + k : NULL;
+    }
+
+    unsigned int at = locate_sorted(sorted->list->items, n, x, mode);
+    if (index) *index = at;
+    return at < n ? sorted->list->items + at : NULL;
+}
+
+static unsigned int bound(Item x, int mode, SortedList *sorted) {
+    unsigned int index;
+    locate(x, mode, &index, sorted);
+    return index;
+}
+
+/*
+ * Lays out the subtree rooted at k by an in-order walk, which visits the
+ * nodes in ascending order. Returns the next sorted position to place.
+ */
+static unsigned int layout(size_t k, unsigned int next, SortedList *sorted) {
+    if (k > sorted->list->length) return next;
+
+    next = layout(2 * k, next, sorted);
+    sorted->eytzinger[k] = sorted->list->items[next];
+    sorted->ranks[k] = next++;
+    return layout(2 * k + 1, next, sorted);
+}
+
+SortedList *sorted_list_new(unsigned int size) {
+    ArrayList *list = array_list_new(size);
+    if (!list) return NULL;
+
+    SortedList *sorted = sorted_list_from(list);
+    if (!sorted) array_list_free(list);
+    return sorted;
+}
+
+SortedList *sorted_list_from(ArrayList *list) {
+    if (!list) return NULL;
+
+    SortedList *sorted = malloc(sizeof(SortedList));
+    if (!sorted) return NULL;
+
+    if (sort(list) == FAILURE) {
+        free(sorted);
+        return NULL;
+    }
+
+    sorted->list = list;
+    sorted->eytzinger = NULL;
+    sorted->ranks = NULL;
+    sorted->_mapped = 0;
+    return sorted;
+}
+
+void sorted_list_free(SortedList *sorted) {
+    if (!sorted) return;
+    sorted_list_drop_index(sorted);
+    array_list_free(sorted->list);
+    free(sorted);
+}
+
+int sorted_list_insert(Item item, SortedList *sorted) {
+    unsigned int index = bound(item, BOUND_UPPER, sorted);
+    sorted_list_drop_index(sorted);
+    return insert((int) index, item, sorted->list);
+}
+
+int sorted_list_remove(Item item, SortedList *sorted) {
+    int index = sorted_list_find(item, sorted);
+    if (index < 0) return FAILURE;
+
+    sorted_list_drop_index(sorted);
+    return remove_index(index, sorted->list);
+}
+
+unsigned int sorted_list_lower_bound(Item item, SortedList *sorted) {
+    return bound(item, BOUND_LOWER, sorted);
+}
+
+unsigned int sorted_list_upper_bound(Item item, SortedList *sorted) {
+    return bound(item, BOUND_UPPER, sorted);
+}
+
+void sorted_list_equal_range(Item item, unsigned int *first, unsigned int *last, SortedList *sorted) {
+    *first = bound(item, BOUND_LOWER, sorted);
+    *last = bound(item, BOUND_UPPER, sorted);
+}
+
+int sorted_list_find(Item item, SortedList *sorted) {
+    int mode = ITEM_IS_FLOATING && ARRAY_LIST_EPSILON > 0 ? BOUND_NEAR : BOUND_LOWER;
+    unsigned int index;
+
+    const Item *at = locate(item, mode, &index, sorted);
+    if (at && same_item(*at, item)) return (int) index;
+    return -1;
+}
+
+int sorted_list_contains(Item item, SortedList *sorted) {
+    int mode = ITEM_IS_FLOATING && ARRAY_LIST_EPSILON > 0 ? BOUND_NEAR : BOUND_LOWER;
+
+    const Item *at = locate(item, mode, NULL, sorted);
+    return at && same_item(*at, item);
+}
+
+int sorted_list_build_index(SortedList *sorted) {
+    size_t n = sorted->list->length;
+    size_t tree_bytes = ((n + 1) * sizeof(Item) + SORTED_LIST_CACHE_LINE - 1) & ~(size_t) (SORTED_LIST_CACHE_LINE - 1);
+    size_t bytes = tree_bytes + (n + 1) * sizeof(unsigned int);
+    size_t mapped = 0;
+    char *block = NULL;
+
+    sorted_list_drop_index(sorted);
+
+    // Aligning position 0 to a line puts the children of each node, and
+    // their descendants a few levels down, together on one line. Mappings
+    // are huge-page aligned, and spare the search most of its TLB misses.
+    // buffer_resize falls back to realloc, which only aligns for malloc, so
+    // its block is kept only when it is a mapping.
+    if (bytes >= BUFFER_MMAP_MIN) {
+        block = buffer_resize(NULL, 0, bytes, &mapped);
+        if (block && !mapped) {
+            free(block);
+            block = NULL;
+        }
+    }
+    if (!block) block = aligned_alloc(SORTED_LIST_CACHE_LINE, (bytes + SORTED_LIST_CACHE_LINE - 1) & ~(size_t) (SORTED_LIST_CACHE_LINE - 1));
+    if (!block) return FAILURE;
+
+    sorted->eytzinger = (Item *) block;
+    sorted->ranks = (unsigned int *) (block + tree_bytes);
+    sorted->_mapped = mapped;
+    layout(1, 0, sorted);
+    return SUCCESS;
+}
+
+void sorted_list_drop_index(SortedList *sorted) {
+    if (!sorted->eytzinger) return;
+
+    buffer_free(sorted->eytzinger, sorted->_mapped);
+    sorted->eytzinger = NULL;
+    sorted->ranks = NULL;
+    sorted->_mapped = 0;
+}
@@ -0,0 +1,162 @@
+/**
+ * @file sorted_list.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief An Array List kept in ascending order, searched in O(log n).
+ *
+ * Inserts go to their place in the order, so every lookup can binary
+ * search. The searches are branchless: each step picks the next half with
+ * a conditional move rather than a jump, so there are no mispredictions
+ * to pay for, and both candidate midpoints are prefetched.
+ *
+ * For read-heavy lists an index can be built: a copy of the items in
+ * Eytzinger (breadth-first) order, where the nodes of the next levels of
+ * a search share a cache line and can be prefetched several levels ahead.
+ * Any insert or removal drops the index until it is built again.
+ *
+ * Items must be totally ordered by <, so floating Items may not be NaN.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_SORTED_LIST_H
+#define WESTLEY_SORTED_LIST_H
+
+#include "array_list.h"
+
+/** The cache line size the index is laid out and prefetched for. */
+#define SORTED_LIST_CACHE_LINE 64
+
+/**
+ * @brief Definition of a @ref Sorted List.
+ */
+typedef struct sortedList {
+    /** The items, in ascending order */
+    ArrayList *list;
+    /** The items in Eytzinger order from position 1, NULL when there is no index */
+    Item *eytzinger;
+    /** The position in list of each item of eytzinger */
+    unsigned int *ranks;
+    /** The size of the mapping holding the index, 0 when it is malloc'd */
+    size_t _mapped;
+} SortedList;
+
+/**
+ * @brief Allocates a new, empty Sorted List for use.
+ *
+ * @param size The initial number of items to make room for.
+ *
+ * @returns *SortedList
+ */
+SortedList *sorted_list_new(unsigned int size);
+
+/**
+ * @brief Sorts an Array List and wraps it in a Sorted List.
+ *
+ * @param list The Array List, which the Sorted List takes ownership of.
+ *
+ * @returns *SortedList, NULL if memory ran out, in which case list is left to the caller.
+ */
+SortedList *sorted_list_from(ArrayList *list);
+
+/**
+ * @brief Destroys a Sorted List and its Array List, and frees the memory back.
+ *
+ * @param sorted The Sorted List to free.
+ */
+void sorted_list_free(SortedList *sorted);
+
+/**
+ * @brief Inserts an item at its place in the order, after any equal items.
+ *
+ * @param item The item to insert.
+ * @param sorted The Sorted List to insert to.
+ *
+ * @returns 1 if the insert was successful, 0 otherwise.
+ */
+int sorted_list_insert(Item item, SortedList *sorted);
+
+/**
+ * @brief Removes one item equal to a value.
+ *
+ * @param item The value to remove.
+ * @param sorted The Sorted List to remove from.
+ *
+ * @returns 1 if an item was removed, 0 otherwise.
+ */
+int sorted_list_remove(Item item, SortedList *sorted);
+
+/**
+ * @brief Finds the first position whose item is not less than a value.
+ *
+ * @param item The value to look for.
+ * @param sorted The Sorted List to search.
+ *
+ * @returns The position, the list's length if every item is less.
+ */
+unsigned int sorted_list_lower_bound(Item item, SortedList *sorted);
+
+/**
+ * @brief Finds the first position whose item is greater than a value.
+ *
+ * @param item The value to look for.
+ * @param sorted The Sorted List to search.
+ *
+ * @returns The position, the list's length if no item is greater.
+ */
+unsigned int sorted_list_upper_bound(Item item, SortedList *sorted);
+
+/**
+ * @brief Finds the run of items equal to a value.
+ *
+ * @param item The value to look for.
+ * @param first Receives the position of the first equal item.
+ * @param last Receives the position after the last equal item, equal to first when there are none.
+ * @param sorted The Sorted List to search.
+ */
+void sorted_list_equal_range(Item item, unsigned int *first, unsigned int *last, SortedList *sorted);
+
+/**
+ * @brief Gets the position of an item in a Sorted List.
+ *
+ * Floating items within ARRAY_LIST_EPSILON match, as with find.
+ *
+ * @param item The item to be searched for.
+ * @param sorted The Sorted List to be searched.
+ *
+ * @returns The position of the first matching item, -1 if the item was not found.
+ */
+int sorted_list_find(Item item, SortedList *sorted);
+
+/**
+ * @brief Finds whether an item is in a Sorted List or not.
+ *
+ * @param item The item to be searched for.
+ * @param sorted The Sorted List to be searched.
+ *
+ * @returns 1 if the Sorted List contains the item, 0 otherwise.
+ */
+int sorted_list_contains(Item item, SortedList *sorted);
+
+/**
+ * @brief Builds the Eytzinger index that speeds up lookups on large lists.
+ *
+ * The index holds a second copy of the items plus a position for each,
+ * in huge pages once it is large enough for the Array List to be.
+ *
+ * @param sorted The Sorted List to index.
+ *
+ * @returns 1 if the index was built, 0 otherwise.
+ */
+int sorted_list_build_index(SortedList *sorted);
+
+/**
+ * @brief Frees a Sorted List's Eytzinger index, if it has one.
+ *
+ * @param sorted The Sorted List to drop the index of.
+ */
+void sorted_list_drop_index(SortedList *sorted);
+
+#endif
@@ -10,6 +10,7 @@
 #include "stack.h"
 #include <stdlib.h>
 #include <math.h>
+#include <limits.h>
 
 Stack *stack_new(unsigned int size)
 {
@@ -20,7 +21,8 @@ Stack *stack_new(unsigned int size)
     stack = malloc(sizeof(Stack));
     if (!stack) return NULL;
 
-    stack->items = malloc(size * sizeof(Item));
+    stack->_mapped = 0;
+    stack->items = buffer_resize(NULL, 0, (size_t) size * sizeof(Item), &stack->_mapped);
     if (!stack->items) {
         free(stack);
         return NULL;
@@ -28,19 +30,24 @@ Stack *stack_new(unsigned int size)
 
     stack->length = 0;
     stack->_allocated = size;
+    stack->growth = BUFFER_GROW_DOUBLE;
+    stack->growth_chunk = BUFFER_DEFAULT_CHUNK;
 
     return stack;
 }
 
 void stack_free(Stack *stack) {
-    free(stack->items);
+    buffer_free(stack->items, stack->_mapped);
     free(stack);
 }
 
 int push(Item item, Stack *stack) {
     if (stack->length == stack->_allocated) {
-        int successful = resize(2 * stack->length, stack);
-        if (!successful) return FAILURE;
+        if (stack->length == UINT_MAX) return FAILURE;
+
+        size_t new_size = buffer_grow(stack->_allocated, (size_t) stack->length + 1, stack->growth, stack->growth_chunk);
+        if (new_size > UINT_MAX) new_size = UINT_MAX;
+        if (!resize((unsigned int) new_size, stack)) return FAILURE;
     }
     stack->items[stack->length] = item;
     stack->length++;
@@ -48,7 +55,7 @@ int push(Item item, Stack *stack) {
 }
 
 int pop(Stack *stack) {
-    if (stack->length = 0) return FAILURE;
+    if (stack->length == 0) return FAILURE;
     stack->length--;
     return SUCCESS;
 }
@@ -73,10 +80,10 @@ int empty(Stack *stack) {
     return stack->length == 0 ? TRUE : FALSE;
 }
 
-int resize(int new_size, Stack *stack) {
+int resize(unsigned int new_size, Stack *stack) {
     if (new_size < stack->length) return FAILURE;
 
-    int *items = realloc(stack->items, sizeof(int) * new_size);
+    Item *items = buffer_resize(stack->items, (size_t) stack->length * sizeof(Item), (size_t) new_size * sizeof(Item), &stack->_mapped);
 
     if (!items) return FAILURE;
 
@@ -86,6 +93,21 @@ int resize(int new_size, Stack *stack) {
     return SUCCESS;
 }
 
+int reserve(unsigned int count, Stack *stack) {
+    if (count <= stack->_allocated) return SUCCESS;
+
+    return resize(count, stack);
+}
+
+int set_growth(int policy, unsigned int chunk, Stack *stack) {
+    if (policy != BUFFER_GROW_DOUBLE && policy != BUFFER_GROW_HALF && policy != BUFFER_GROW_CHUNK) return FAILURE;
+
+    stack->growth = policy;
+    stack->growth_chunk = chunk ? chunk : BUFFER_DEFAULT_CHUNK;
+
+    return SUCCESS;
+}
+
 int compress(Stack *stack) {
     return resize(stack->length, stack);
 }
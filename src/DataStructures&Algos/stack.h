@@ -11,6 +11,8 @@
 #ifndef WESTLEY_STACK_H
 #define WESTLEY_STACK_H
 
+#include "buffer.h"
+
 #define TRUE 1
 #define FALSE 0
 
@@ -33,6 +35,12 @@ typedef struct stack {
     unsigned int length;
     /** Allocated length of the stack.*/
     unsigned int _allocated;
+    /** How the stack grows when full: BUFFER_GROW_DOUBLE, BUFFER_GROW_HALF or BUFFER_GROW_CHUNK */
+    int growth;
+    /** The number of items added per growth under BUFFER_GROW_CHUNK */
+    unsigned int growth_chunk;
+    /** The size of the mapping holding items, 0 when items is malloc'd */
+    size_t _mapped;
 } Stack;
 
 /**
@@ -107,12 +115,36 @@ int empty(Stack *stack);
 /**
  * @brief Changes the size of a stack.
  *
+ * Stacks of BUFFER_MMAP_MIN bytes or more are kept in a huge-page mapping
+ * on Linux, so they grow without copying their items.
+ *
  * @param new_size The new size of the stack.
  * @param stack The stack to be altered.
  * 
  * @returns 1 if the change was successful, 0 otherwise.
  */
-int resize(int new_size, Stack *stack);
+int resize(unsigned int new_size, Stack *stack);
+
+/**
+ * @brief Makes room for a number of items, so the stack can reach that length without growing.
+ *
+ * @param count The number of items to make room for.
+ * @param stack The stack to be altered.
+ *
+ * @returns 1 if the stack has room for count items, 0 otherwise.
+ */
+int reserve(unsigned int count, Stack *stack);
+
+/**
+ * @brief Chooses how a stack grows once it is full.
+ *
+ * @param policy BUFFER_GROW_DOUBLE, BUFFER_GROW_HALF or BUFFER_GROW_CHUNK.
+ * @param chunk The number of items added per growth under BUFFER_GROW_CHUNK, 0 for BUFFER_DEFAULT_CHUNK.
+ * @param stack The stack to configure.
+ *
+ * @returns 1 if the policy was set, 0 if it is not a known policy.
+ */
+int set_growth(int policy, unsigned int chunk, Stack *stack);
 
 /**
  * @brief Reduces the size of a stack to its length.
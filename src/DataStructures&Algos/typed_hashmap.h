@@ -0,0 +1,229 @@
+/**
+ * @file typed_hashmap.h
+ *
+ * @author AJ Westley (alexanderjwestley@gmail.com)
+ *
+ * @brief A generator for type-specialised key-value Hash Maps.
+ *
+ * DEFINE_HASHMAP(name, K, V, hash, eq) emits a map type called name and a
+ * family of static inline functions prefixed with name_, for example:
+ *
+ *     static uint64_t int_hash(int k, uint64_t seed) { return hash_u64(k, seed); }
+ *     static int int_eq(int a, int b) { return a == b; }
+ *     DEFINE_HASHMAP(IntMap, int, int, int_hash, int_eq)
+ *
+ *     IntMap *map = IntMap_new(0);
+ *     IntMap_insert(4, 16, map);
+ *
+ * hash(K key, uint64_t seed) must return a 64-bit hash and eq(K a, K b)
+ * must return non-zero when two keys are equal. Both are called directly,
+ * so the compiler can inline them, and any number of map types can live in
+ * one program.
+ *
+ * The maps use open addressing with linear probing. A metadata byte per
+ * slot holds a 7-bit hash fragment, so most mismatches are rejected
+ * without calling eq.
+ *
+ * @date 17-10-2026
+ *
+ */
+
+#ifndef WESTLEY_TYPED_HASHMAP_H
+#define WESTLEY_TYPED_HASHMAP_H
+
+#define TRUE 1
+#define FALSE 0
+
+#define SUCCESS 1
+#define FAILURE 0
+
+#include "hash.h"
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#define TYPED_HASHMAP_EMPTY 0x00
+#define TYPED_HASHMAP_DELETED 0x01
+
+/* A full slot's metadata byte: the high bit set plus 7 bits of hash. */
+#define TYPED_HASHMAP_FULL(hash) ((unsigned char) (0x80 | ((hash) >> 57)))
+
+/* The largest power of two an unsigned int capacity can hold. */
+#define TYPED_HASHMAP_MAX_CAPACITY (UINT_MAX / 2 + 1)
+
+#define DEFINE_HASHMAP(name, K, V, hash, eq)                                            \
+                                                                                        \
+typedef struct name##_struct {                                                          \
+    /** The number of slots (a power of two) */                                         \
+    unsigned int capacity;                                                              \
+    /** The number of key-value pairs */                                                \
+    unsigned int item_count;                                                            \
+    /** The number of DELETED slots */                                                  \
+    unsigned int tombstones;                                                            \
+    /** One byte per slot: EMPTY, DELETED or FULL with a hash fragment */               \
+    unsigned char *meta;                                                                \
+    K *keys;                                                                            \
+    V *values;                                                                          \
+    /** The seed passed to hash, random per map */                                      \
+    uint64_t seed;                                                                      \
+} name;                                                                                 \
+                                                                                        \
+static inline int name##_alloc_(unsigned int capacity, name *map) {                     \
+    unsigned char *meta = calloc(capacity, 1);                                          \
+    K *keys = malloc(capacity * sizeof(K));                                             \
+    V *values = malloc(capacity * sizeof(V));                                           \
+    if (!meta || !keys || !values) {                                                    \
+        free(meta);                                                                     \
+        free(keys);                                                                     \
+        free(values);                                                                   \
+        return FAILURE;                                                                 \
+    }                                                                                   \
+    map->meta = meta;                                                                   \
+    map->keys = keys;                                                                   \
+    map->values = values;                                                               \
+    map->capacity = capacity;                                                           \
+    map->tombstones = 0;                                                                \
+    return SUCCESS;                                                                     \
+}                                                                                       \
+                                                                                        \
+static inline name *name##_new(unsigned int size) {                                     \
+    unsigned int capacity = 16;                                                         \
+    while (capacity / 8 * 7 < size) {                                                   \
+        if (capacity == TYPED_HASHMAP_MAX_CAPACITY) return NULL;                        \
+        capacity *= 2;                                                                  \
+    }                                                                                   \
+                                                                                        \
+    name *map = malloc(sizeof(name));                                                   \
+    if (!map) return NULL;                                                              \
+    if (!name##_alloc_(capacity, map)) {                                                \
+        free(map);                                                                      \
+        return NULL;                                                                    \
+    }                                                                                   \
+    map->item_count = 0;                                                                \
+    map->seed = hash_random_seed();                                                     \
+    return map;                                                                         \
+}                                                                                       \
+                                                                                        \
+static inline void name##_free(name *map) {                                             \
+    free(map->meta);                                                                    \
+    free(map->keys);                                                                    \
+    free(map->values);                                                                  \
+    free(map);                                                                          \
+}                                                                                       \
+                                                                                        \
+static inline long name##_find_(K key, uint64_t h, name *map) {                         \
+    unsigned int mask = map->capacity - 1;                                              \
+    unsigned char full = TYPED_HASHMAP_FULL(h);                                         \
+    for (unsigned int i = (unsigned int) h & mask; ; i = (i + 1) & mask) {              \
+        unsigned char m = map->meta[i];                                                 \
+        if (m == TYPED_HASHMAP_EMPTY) return -1;                                        \
+        if (m == full && eq(key, map->keys[i])) return i;                               \
+    }                                                                                   \
+}                                                                                       \
+                                                                                        \
+static inline unsigned int name##_free_slot_(uint64_t h, name *map) {                   \
+    unsigned int mask = map->capacity - 1;                                              \
+    unsigned int i = (unsigned int) h & mask;                                           \
+    while (map->meta[i] & 0x80) i = (i + 1) & mask;                                     \
+    return i;                                                                           \
+}                                                                                       \
+                                                                                        \
+/* Rebuilds the table, doubling it unless it is mostly tombstones. */                   \
+static inline int name##_rehash_(name *map) {                                           \
+    name old = *map;                                                                    \
+    unsigned int capacity = old.capacity;                                               \
+    if (old.item_count >= capacity / 16 * 7) {                                          \
+        if (capacity == TYPED_HASHMAP_MAX_CAPACITY) return FAILURE;                     \
+        capacity *= 2;                                                                  \
+    }                                                                                   \
+    if (!name##_alloc_(capacity, map)) {                                                \
+        *map = old;                                                                     \
+        return FAILURE;                                                                 \
+    }                                                                                   \
+    for (unsigned int i = 0; i < old.capacity; i++) {                                   \
+        if (!(old.meta[i] & 0x80)) continue;                                            \
+        uint64_t h = hash(old.keys[i], map->seed);                                      \
+        unsigned int slot = name##_free_slot_(h, map);                                  \
+        map->meta[slot] = TYPED_HASHMAP_FULL(h);                                        \
+        map->keys[slot] = old.keys[i];                                                  \
+        map->values[slot] = old.values[i];                                              \
+    }                                                                                   \
+    free(old.meta);                                                                     \
+    free(old.keys);                                                                     \
+    free(old.values);                                                                   \
+    return SUCCESS;                                                                     \
+}                                                                                       \
+                                                                                        \
+static inline int name##_place_(K key, V val, uint64_t h, name *map) {                  \
+    if ((map->item_count + map->tombstones + 1) > map->capacity / 8 * 7) {              \
+        if (!name##_rehash_(map)) return FAILURE;                                       \
+    }                                                                                   \
+    unsigned int slot = name##_free_slot_(h, map);                                      \
+    if (map->meta[slot] == TYPED_HASHMAP_DELETED) map->tombstones--;                    \
+    map->meta[slot] = TYPED_HASHMAP_FULL(h);                                            \
+    map->keys[slot] = key;                                                              \
+    map->values[slot] = val;                                                            \
+    map->item_count++;                                                                  \
+    return SUCCESS;                                                                     \
+}                                                                                       \
+                                                                                        \
+/** Inserts a key-value pair. Returns 1 if successful, 0 otherwise. */                  \
+static inline int name##_insert(K key, V val, name *map) {                              \
+    return name##_place_(key, val, hash(key, map->seed), map);                          \
+}                                                                                       \
+                                                                                        \
+/** Inserts a key-value pair if the key is absent. Returns 1 if inserted. */            \
+static inline int name##_insert_if_absent(K key, V val, name *map) {                    \
+    uint64_t h = hash(key, map->seed);                                                  \
+    if (name##_find_(key, h, map) != -1) return FAILURE;                                \
+    return name##_place_(key, val, h, map);                                             \
+}                                                                                       \
+                                                                                        \
+/** Removes a key. Returns 1 if the key was removed, 0 otherwise. */                    \
+static inline int name##_remove(K key, name *map) {                                     \
+    long slot = name##_find_(key, hash(key, map->seed), map);                           \
+    if (slot == -1) return FAILURE;                                                     \
+    unsigned int next = ((unsigned int) slot + 1) & (map->capacity - 1);                \
+    if (map->meta[next] == TYPED_HASHMAP_EMPTY) {                                       \
+        map->meta[slot] = TYPED_HASHMAP_EMPTY;                                          \
+    }                                                                                   \
+    else {                                                                              \
+        map->meta[slot] = TYPED_HASHMAP_DELETED;                                        \
+        map->tombstones++;                                                              \
+    }                                                                                   \
+    map->item_count--;                                                                  \
+    return SUCCESS;                                                                     \
+}                                                                                       \
+                                                                                        \
+/** Returns a pointer to a key's value, NULL if absent. Invalidated by inserts. */      \
+static inline V *name##_get(K key, name *map) {                                         \
+    long slot = name##_find_(key, hash(key, map->seed), map);                           \
+    return slot == -1 ? NULL : &map->values[slot];                                      \
+}                                                                                       \
+                                                                                        \
+/** Sets a key's value. Returns 1 if the key was found, 0 otherwise. */                 \
+static inline int name##_set(K key, V new_val, name *map) {                             \
+    V *val = name##_get(key, map);                                                      \
+    if (!val) return FAILURE;                                                           \
+    *val = new_val;                                                                     \
+    return SUCCESS;                                                                     \
+}                                                                                       \
+                                                                                        \
+/** Returns 1 if the key is in the map, 0 otherwise. */                                 \
+static inline int name##_contains(K key, name *map) {                                   \
+    return name##_get(key, map) ? TRUE : FALSE;                                         \
+}                                                                                       \
+                                                                                        \
+/** Returns 1 if the map is empty, 0 otherwise. */                                      \
+static inline int name##_empty(name *map) {                                             \
+    return map->item_count == 0 ? TRUE : FALSE;                                         \
+}                                                                                       \
+                                                                                        \
+/** Removes all key-value pairs. */                                                     \
+static inline void name##_clear(name *map) {                                            \
+    memset(map->meta, TYPED_HASHMAP_EMPTY, map->capacity);                              \
+    map->item_count = 0;                                                                \
+    map->tombstones = 0;                                                                \
+}
+
+#endif